@@ -44,10 +44,17 @@
 #define AT45DB_CHIP_ERASE_ADDR 0x94809A /* Magic address. See usage. */
 #define AT45DB_BUFFER1_WRITE 0x84
 #define AT45DB_BUFFER1_PAGE_PROGRAM 0x88
-/* Buffer 2 is unused yet.
 #define AT45DB_BUFFER2_WRITE 0x87
 #define AT45DB_BUFFER2_PAGE_PROGRAM 0x89
-*/
+
+/* Opcodes to fill and program the SRAM buffers. */
+static const struct {
+	uint8_t write;
+	uint8_t page_program;
+} at45db_buffers[] = {
+	{ AT45DB_BUFFER1_WRITE, AT45DB_BUFFER1_PAGE_PROGRAM },
+	{ AT45DB_BUFFER2_WRITE, AT45DB_BUFFER2_PAGE_PROGRAM },
+};
 
 static uint8_t at45db_read_status_register(struct flashctx *flash, uint8_t *status)
 {
@@ -457,7 +464,8 @@ int spi_erase_at45cs_sector(struct flashctx *flash, unsigned int addr, unsigned
 	return at45db_erase(flash, opcode, at45db_convert_addr(addr, page_size), 200000, 100);
 }
 
-static int at45db_fill_buffer1(struct flashctx *flash, const uint8_t *bytes, unsigned int off, unsigned int len)
+static int at45db_fill_buffer(struct flashctx *flash, unsigned int buffer, const uint8_t *bytes, unsigned int off,
+			      unsigned int len)
 {
 	const unsigned int page_size = flash->chip->page_size;
 	if ((off + len) > page_size) {
@@ -466,13 +474,13 @@ static int at45db_fill_buffer1(struct flashctx *flash, const uint8_t *bytes, uns
 		return 1;
 	}
 
-	/* Create a suitable buffer to store opcode, address and data chunks for buffer1. */
+	/* Create a suitable buffer to store opcode, address and data chunks for the SRAM buffer. */
 	const int max_data_write = flash->mst->spi.max_data_write - 4;
 	const unsigned int max_chunk = (max_data_write > 0 && max_data_write <= page_size) ?
 				       max_data_write : page_size;
 	uint8_t buf[4 + max_chunk];
 
-	buf[0] = AT45DB_BUFFER1_WRITE;
+	buf[0] = at45db_buffers[buffer].write;
 	while (off < page_size) {
 		unsigned int cur_chunk = min(max_chunk, page_size - off);
 		buf[1] = (off >> 16) & 0xff;
@@ -489,10 +497,11 @@ static int at45db_fill_buffer1(struct flashctx *flash, const uint8_t *bytes, uns
 	return 0;
 }
 
-static int at45db_commit_buffer1(struct flashctx *flash, unsigned int at45db_addr)
+/* Start programming an SRAM buffer into main memory. Completion has to be awaited with at45db_wait_program(). */
+static int at45db_commit_buffer(struct flashctx *flash, unsigned int buffer, unsigned int at45db_addr)
 {
 	const uint8_t cmd[] = {
-		AT45DB_BUFFER1_PAGE_PROGRAM,
+		at45db_buffers[buffer].page_program,
 		(at45db_addr >> 16) & 0xff,
 		(at45db_addr >> 8) & 0xff,
 		(at45db_addr >> 0) & 0xff
@@ -500,36 +509,18 @@ static int at45db_commit_buffer1(struct flashctx *flash, unsigned int at45db_add
 
 	/* Send buffer to device. */
 	int ret = spi_send_command(flash, sizeof(cmd), 0, cmd, NULL);
-	if (ret != 0) {
+	if (ret != 0)
 		msg_cerr("%s: error sending buffer to main memory command!\n", __func__);
-		return ret;
-	}
-
-	/* Wait for completion (typically a few ms). */
-	ret = at45db_wait_ready(flash, 250, 200); // 50 ms
-	if (ret != 0) {
-		msg_cerr("%s: chip did not become ready again!\n", __func__);
-		return ret;
-	}
-
-	return 0;
+	return ret;
 }
 
-static int at45db_program_page(struct flashctx *flash, const uint8_t *buf, unsigned int at45db_addr)
+static int at45db_wait_program(struct flashctx *flash)
 {
-	int ret = at45db_fill_buffer1(flash, buf, 0, flash->chip->page_size);
-	if (ret != 0) {
-		msg_cerr("%s: filling the buffer failed!\n", __func__);
-		return ret;
-	}
-
-	ret = at45db_commit_buffer1(flash, at45db_addr);
-	if (ret != 0) {
-		msg_cerr("%s: committing page failed!\n", __func__);
-		return ret;
-	}
-
-	return 0;
+	/* Wait for completion (typically a few ms). */
+	int ret = at45db_wait_ready(flash, 250, 200); // 50 ms
+	if (ret != 0)
+		msg_cerr("%s: chip did not become ready again!\n", __func__);
+	return ret;
 }
 
 int spi_write_at45db(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
@@ -548,12 +539,31 @@ int spi_write_at45db(struct flashctx *flash, const uint8_t *buf, unsigned int st
 		return 1;
 	}
 
+	/* Chips with two SRAM buffers get the next page loaded into one buffer while the other one is being
+	 * programmed. Only the chip's page programming has to be finished before the next commit then.
+	 * A single buffer can not be refilled before it has been programmed.
+	 */
+	const unsigned int buffers = (flash->chip->feature_bits & FEATURE_AT45DB_BUFFER2) ? 2 : 1;
 	unsigned int i;
 	for (i = 0; i < len; i += page_size) {
-		if (at45db_program_page(flash, buf + i, at45db_convert_addr(start + i, page_size)) != 0) {
-			msg_cerr("Writing page %u failed!\n", i);
-			return 1;
+		const unsigned int buffer = (i / page_size) % buffers;
+		if (i > 0 && buffers == 1 && at45db_wait_program(flash) != 0)
+			goto fail;
+		if (at45db_fill_buffer(flash, buffer, buf + i, 0, page_size) != 0) {
+			msg_cerr("%s: filling the buffer failed!\n", __func__);
+			goto fail;
 		}
+		if (i > 0 && buffers == 2 && at45db_wait_program(flash) != 0)
+			goto fail;
+		if (at45db_commit_buffer(flash, buffer, at45db_convert_addr(start + i, page_size)) != 0)
+			goto fail;
+	}
+	if (len > 0 && at45db_wait_program(flash) != 0) {
+		i -= page_size;
+		goto fail;
 	}
 	return 0;
+fail:
+	msg_cerr("Writing page %u failed!\n", i);
+	return 1;
 }
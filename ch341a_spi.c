@@ -22,9 +22,12 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <libusb.h>
 #include "flash.h"
+#include "chipdrivers.h"
 #include "programmer.h"
+#include "spi.h"
 
 /* LIBUSB_CALL ensures the right calling conventions on libusb callbacks.
  * However, the macro is not defined everywhere. m(
@@ -135,14 +138,53 @@ static void LIBUSB_CALL cb_in(struct libusb_transfer *transfer)
 	cb_common(__func__, transfer);
 }
 
-static int32_t usb_transfer(const char *func, unsigned int writecnt, unsigned int readcnt, const uint8_t *writearr, uint8_t *readarr)
+/* Cancel all ongoing requests and wait for them to be canceled. */
+static void cancel_transfers(int *state_out, int *state_in)
+{
+	unsigned int i;
+	bool finished;
+
+	if (*state_out == TRANS_ACTIVE && libusb_cancel_transfer(transfer_out) != 0)
+		*state_out = TRANS_ERR;
+	for (i = 0; i < USB_IN_TRANSFERS; i++) {
+		if (state_in[i] == TRANS_ACTIVE && libusb_cancel_transfer(transfer_ins[i]) != 0)
+			state_in[i] = TRANS_ERR;
+	}
+
+	/* Wait for cancellations to complete. */
+	while (1) {
+		finished = *state_out != TRANS_ACTIVE;
+		for (i = 0; i < USB_IN_TRANSFERS; i++) {
+			if (state_in[i] == TRANS_ACTIVE)
+				finished = false;
+		}
+		if (finished)
+			break;
+		libusb_handle_events_timeout(NULL, &(struct timeval){1, 0});
+	}
+}
+
+/* Write segcnt OUT transfers of seglen[] bytes of writearr back to back while reading the segread[] bytes replied
+ * to each of them. Only the last packet of a transfer may be shorter than CH341_PACKET_LENGTH, hence commands that
+ * end in a short packet need a segment of their own to be followed by further commands. */
+static int32_t usb_transfer_segments(const char *func, unsigned int segcnt, const unsigned int *seglen,
+				     const unsigned int *segread, const uint8_t *writearr, uint8_t *readarr)
 {
 	if (handle == NULL)
 		return -1;
 
+	unsigned int writecnt = 0;
+	unsigned int readcnt = 0;
+	unsigned int seg = 0;
+	for (seg = 0; seg < segcnt; seg++) {
+		writecnt += seglen[seg];
+		readcnt += segread[seg];
+	}
+	seg = 0;
+
 	int state_out = TRANS_IDLE;
 	transfer_out->buffer = (uint8_t*)writearr;
-	transfer_out->length = writecnt;
+	transfer_out->length = segcnt ? seglen[0] : 0;
 	transfer_out->user_data = &state_out;
 
 	/* Schedule write first */
@@ -163,12 +205,17 @@ static int32_t usb_transfer(const char *func, unsigned int writecnt, unsigned in
 	unsigned int in_done = 0;
 	unsigned int in_active = 0;
 	unsigned int out_done = 0;
+	unsigned int read_seg = 0; /* The segment whose replies are scheduled next. */
+	unsigned int read_left = segcnt ? segread[0] : 0; /* Bytes of it that are not scheduled yet. */
 	uint8_t *in_buf = readarr;
 	int state_in[USB_IN_TRANSFERS] = {0};
 	do {
 		/* Schedule new reads as long as there are free transfers and unscheduled bytes to read. */
 		while ((in_done + in_active) < readcnt && state_in[free_idx] == TRANS_IDLE) {
-			unsigned int cur_todo = min(CH341_PACKET_LENGTH - 1, readcnt - in_done - in_active);
+			/* Every segment ends in a short packet whose reply is a transfer of its own. */
+			while (!read_left)
+				read_left = segread[++read_seg];
+			unsigned int cur_todo = min(CH341_PACKET_LENGTH - 1, read_left);
 			transfer_ins[free_idx]->length = cur_todo;
 			transfer_ins[free_idx]->buffer = in_buf;
 			transfer_ins[free_idx]->user_data = &state_in[free_idx];
@@ -181,6 +228,7 @@ static int32_t usb_transfer(const char *func, unsigned int writecnt, unsigned in
 			}
 			in_buf += cur_todo;
 			in_active += cur_todo;
+			read_left -= cur_todo;
 			state_in[free_idx] = TRANS_ACTIVE;
 			free_idx = (free_idx + 1) % USB_IN_TRANSFERS; /* Increment (and wrap around). */
 		}
@@ -195,6 +243,19 @@ static int32_t usb_transfer(const char *func, unsigned int writecnt, unsigned in
 			} else if (state_out > 0) {
 				out_done += state_out;
 				state_out = TRANS_IDLE;
+				/* Queue the next segment without waiting for any reads. */
+				if (out_done < writecnt) {
+					transfer_out->buffer = (uint8_t*)writearr + out_done;
+					transfer_out->length = seglen[++seg];
+					state_out = TRANS_ACTIVE;
+					int ret = libusb_submit_transfer(transfer_out);
+					if (ret) {
+						msg_perr("%s: failed to submit OUT transfer: %s\n",
+							 func, libusb_error_name(ret));
+						state_out = TRANS_ERR;
+						goto err;
+					}
+				}
 			}
 		}
 		/* Check for completed transfers. */
@@ -225,39 +286,15 @@ err:
 	/* Clean up on errors. */
 	msg_perr("%s: Failed to %s %d bytes\n", func, (state_out == TRANS_ERR) ? "write" : "read",
 		 (state_out == TRANS_ERR) ? writecnt : readcnt);
-	/* First, we must cancel any ongoing requests and wait for them to be canceled. */
-	if ((writecnt > 0) && (state_out == TRANS_ACTIVE)) {
-		if (libusb_cancel_transfer(transfer_out) != 0)
-			state_out = TRANS_ERR;
-	}
-	if (readcnt > 0) {
-		unsigned int i;
-		for (i = 0; i < USB_IN_TRANSFERS; i++) {
-			if (state_in[i] == TRANS_ACTIVE)
-				if (libusb_cancel_transfer(transfer_ins[i]) != 0)
-					state_in[i] = TRANS_ERR;
-		}
-	}
-
-	/* Wait for cancellations to complete. */
-	while (1) {
-		bool finished = true;
-		if ((writecnt > 0) && (state_out == TRANS_ACTIVE))
-			finished = false;
-		if (readcnt > 0) {
-			unsigned int i;
-			for (i = 0; i < USB_IN_TRANSFERS; i++) {
-				if (state_in[i] == TRANS_ACTIVE)
-					finished = false;
-			}
-		}
-		if (finished)
-			break;
-		libusb_handle_events_timeout(NULL, &(struct timeval){1, 0});
-	}
+	cancel_transfers(&state_out, state_in);
 	return -1;
 }
 
+static int32_t usb_transfer(const char *func, unsigned int writecnt, unsigned int readcnt, const uint8_t *writearr, uint8_t *readarr)
+{
+	return usb_transfer_segments(func, 1, &writecnt, &readcnt, writearr, readarr);
+}
+
 /*   Set the I2C bus speed (speed(b1b0): 0 = 20kHz; 1 = 100kHz, 2 = 400kHz, 3 = 750kHz).
  *   Set the SPI bus data width (speed(b2): 0 = Single, 1 = Double).  */
 static int32_t config_stream(uint32_t speed)
@@ -279,12 +316,18 @@ static int32_t config_stream(uint32_t speed)
 }
 
 /* ch341 requires LSB first, swap the bit order before send and after receive */
-static uint8_t swap_byte(uint8_t x)
+#define R2(n)	(n), (n) + 2 * 64, (n) + 1 * 64, (n) + 3 * 64
+#define R4(n)	R2(n), R2((n) + 2 * 16), R2((n) + 1 * 16), R2((n) + 3 * 16)
+#define R6(n)	R4(n), R4((n) + 2 * 4), R4((n) + 1 * 4), R4((n) + 3 * 4)
+static const uint8_t reversed_bits[256] = { R6(0), R6(2), R6(1), R6(3) };
+#undef R6
+#undef R4
+#undef R2
+
+static void swap_bytes(uint8_t *dst, const uint8_t *src, unsigned int len)
 {
-	x = ((x >> 1) & 0x55) | ((x << 1) & 0xaa);
-	x = ((x >> 2) & 0x33) | ((x << 2) & 0xcc);
-	x = ((x >> 4) & 0x0f) | ((x << 4) & 0xf0);
-	return x;
+	while (len--)
+		*dst++ = reversed_bits[*src++];
 }
 
 /* The assumed map between UIO command bits, pins on CH341A chip and pins on SPI chip:
@@ -348,6 +391,32 @@ void ch341a_spi_delay(unsigned int usecs)
 	stored_delay_us += usecs;
 }
 
+/* Fill SPI stream packets that clock out writecnt bytes of writearr followed by readcnt dummy bytes. All packets
+ * but the last are full. Returns the number of bytes used. */
+static unsigned int fill_spi_stream(uint8_t *ptr, unsigned int writecnt, unsigned int readcnt,
+				    const unsigned char *writearr)
+{
+	const unsigned int packets = (writecnt + readcnt + CH341_PACKET_LENGTH - 2) / (CH341_PACKET_LENGTH - 1);
+	unsigned int write_left = writecnt;
+	unsigned int read_left = readcnt;
+	unsigned int p;
+	for (p = 0; p < packets; p++) {
+		unsigned int write_now = min(CH341_PACKET_LENGTH - 1, write_left);
+		unsigned int read_now = min ((CH341_PACKET_LENGTH - 1) - write_now, read_left);
+		*ptr++ = CH341A_CMD_SPI_STREAM;
+		swap_bytes(ptr, writearr, write_now);
+		ptr += write_now;
+		writearr += write_now;
+		if (read_now) {
+			memset(ptr, 0xFF, read_now);
+			ptr += read_now;
+			read_left -= read_now;
+		}
+		write_left -= write_now;
+	}
+	return packets + writecnt + readcnt;
+}
+
 static int ch341a_spi_spi_send_command(struct flashctx *flash, unsigned int writecnt, unsigned int readcnt, const unsigned char *writearr, unsigned char *readarr)
 {
 	if (handle == NULL)
@@ -362,39 +431,262 @@ static int ch341a_spi_spi_send_command(struct flashctx *flash, unsigned int writ
 	/* Initialize the write buffer to zero to prevent writing random stack contents to device. */
 	memset(wbuf[0], 0, CH341_PACKET_LENGTH);
 
-	uint8_t *ptr = wbuf[0];
 	/* CS usage is optimized by doing both transitions in one packet.
 	 * Final transition to deselected state is in the pin disable. */
-	pluck_cs(ptr);
-	unsigned int write_left = writecnt;
-	unsigned int read_left = readcnt;
-	unsigned int p;
-	for (p = 0; p < packets; p++) {
-		unsigned int write_now = min(CH341_PACKET_LENGTH - 1, write_left);
-		unsigned int read_now = min ((CH341_PACKET_LENGTH - 1) - write_now, read_left);
-		ptr = wbuf[p+1];
-		*ptr++ = CH341A_CMD_SPI_STREAM;
-		unsigned int i;
-		for (i = 0; i < write_now; ++i)
-			*ptr++ = swap_byte(*writearr++);
-		if (read_now) {
-			memset(ptr, 0xFF, read_now);
-			read_left -= read_now;
-		}
-		write_left -= write_now;
-	}
+	pluck_cs(wbuf[0]);
+	fill_spi_stream(wbuf[1], writecnt, readcnt, writearr);
 
 	int32_t ret = usb_transfer(__func__, CH341_PACKET_LENGTH + packets + writecnt + readcnt,
 				    writecnt + readcnt, wbuf[0], rbuf);
 	if (ret < 0)
 		return -1;
 
-	unsigned int i;
-	for (i = 0; i < readcnt; i++) {
-		*readarr++ = swap_byte(rbuf[writecnt + i]);
+	swap_bytes(readarr, rbuf + writecnt, readcnt);
+	return 0;
+}
+
+/* Longest CS deassertion done by the device, longer delays are left to the host. */
+#define CH341A_MAX_GAP_US	5000
+
+/* Output instructions repeated in the CS packets to make the deassertion last at least us microseconds. Each takes
+ * 750 ns, see pluck_cs(). */
+static unsigned int cs_gap_repeats(unsigned int us)
+{
+	return max(2, (us * 4 + 2) / 3);
+}
+
+/* The first CS packet has room for 28 repeats, the following ones for 29 each. */
+static unsigned int cs_gap_packets(unsigned int us)
+{
+	const unsigned int repeats = cs_gap_repeats(us);
+	return repeats <= 28 ? 1 : 1 + (repeats - 28 + 28) / 29;
+}
+
+/* Like pluck_cs() but for arbitrary long delays spanning several packets. Returns the number of bytes used. */
+static unsigned int fill_cs_gap(uint8_t *ptr, unsigned int us)
+{
+	unsigned int repeats = cs_gap_repeats(us);
+	uint8_t *const start = ptr;
+	uint8_t *pkt = ptr;
+
+	memset(ptr, 0, CH341_PACKET_LENGTH * cs_gap_packets(us));
+	*ptr++ = CH341A_CMD_UIO_STREAM;
+	*ptr++ = CH341A_CMD_UIO_STM_OUT | 0x37; /* deasserted */
+	for (; repeats; repeats--) {
+		/* Keep room for the assertion and the end of the packet. */
+		if (ptr == pkt + CH341_PACKET_LENGTH - 2) {
+			*ptr = CH341A_CMD_UIO_STM_END;
+			pkt += CH341_PACKET_LENGTH;
+			ptr = pkt;
+			*ptr++ = CH341A_CMD_UIO_STREAM;
+		}
+		*ptr++ = CH341A_CMD_UIO_STM_OUT | 0x37; /* "delay" */
 	}
+	*ptr++ = CH341A_CMD_UIO_STM_OUT | 0x36; /* asserted */
+	*ptr++ = CH341A_CMD_UIO_STM_END;
+	return pkt - start + CH341_PACKET_LENGTH;
+}
+
+/*
+ * Send the commands and the RDSR polls without waiting for any replies in between. The delays are done by the
+ * device by keeping CS deasserted in UIO stream packets. Each command and poll ends in a short packet and thus
+ * is an OUT transfer of its own, but all of them are queued in one go.
+ */
+static int ch341a_spi_multicommand_poll(struct flashctx *flash, struct spi_command *cmds, unsigned int delay_us,
+					unsigned int step_us, unsigned int count, uint8_t *status)
+{
+	static const unsigned char cmd_rdsr[JEDEC_RDSR_OUTSIZE] = { JEDEC_RDSR };
+	struct spi_command *cmd;
+	unsigned int segcnt = count, writecnt = 0, readcnt = 0, seg = 0, pos = 0, k;
+	/* The delay of a command is done in the CS packets in front of the next one. */
+	unsigned int gap_us = stored_delay_us;
 
+	if (handle == NULL)
+		return -1;
+	for (cmd = cmds; cmd->writecnt || cmd->readcnt; cmd++) {
+		const unsigned int len = cmd->writecnt + cmd->readcnt;
+		if (cmd->delay_us > CH341A_MAX_GAP_US)
+			return SPI_INVALID_OPCODE;
+		segcnt++;
+		writecnt += CH341_PACKET_LENGTH * cs_gap_packets(gap_us) +
+			    (len + CH341_PACKET_LENGTH - 2) / (CH341_PACKET_LENGTH - 1) + len;
+		readcnt += len;
+		gap_us = cmd->delay_us;
+	}
+	if (delay_us > CH341A_MAX_GAP_US || step_us > CH341A_MAX_GAP_US)
+		return SPI_INVALID_OPCODE;
+	for (k = 0; k < count; k++) {
+		writecnt += CH341_PACKET_LENGTH * cs_gap_packets(gap_us + (k ? step_us : delay_us)) + 1 +
+			    JEDEC_RDSR_OUTSIZE + JEDEC_RDSR_INSIZE;
+		readcnt += JEDEC_RDSR_OUTSIZE + JEDEC_RDSR_INSIZE;
+		gap_us = 0;
+	}
+
+	unsigned int *seglen = malloc(segcnt * sizeof(*seglen));
+	unsigned int *segread = malloc(segcnt * sizeof(*segread));
+	uint8_t *wbuf = malloc(writecnt);
+	uint8_t *rbuf = malloc(readcnt);
+	if (!seglen || !segread || !wbuf || !rbuf) {
+		msg_perr("Out of memory!\n");
+		free(seglen);
+		free(segread);
+		free(wbuf);
+		free(rbuf);
+		return SPI_GENERIC_ERROR;
+	}
+
+	gap_us = stored_delay_us;
+	stored_delay_us = 0;
+	for (cmd = cmds; cmd->writecnt || cmd->readcnt; cmd++) {
+		seglen[seg] = fill_cs_gap(wbuf + pos, gap_us);
+		seglen[seg] += fill_spi_stream(wbuf + pos + seglen[seg], cmd->writecnt, cmd->readcnt,
+					       cmd->writearr);
+		segread[seg] = cmd->writecnt + cmd->readcnt;
+		pos += seglen[seg++];
+		gap_us = cmd->delay_us;
+	}
+	for (k = 0; k < count; k++) {
+		seglen[seg] = fill_cs_gap(wbuf + pos, gap_us + (k ? step_us : delay_us));
+		gap_us = 0;
+		seglen[seg] += fill_spi_stream(wbuf + pos + seglen[seg], sizeof(cmd_rdsr), JEDEC_RDSR_INSIZE,
+					       cmd_rdsr);
+		segread[seg] = JEDEC_RDSR_OUTSIZE + JEDEC_RDSR_INSIZE;
+		pos += seglen[seg++];
+	}
+
+	int32_t ret = usb_transfer_segments(__func__, segcnt, seglen, segread, wbuf, rbuf);
+	if (ret >= 0) {
+		pos = 0;
+		for (cmd = cmds; cmd->writecnt || cmd->readcnt; cmd++) {
+			swap_bytes(cmd->readarr, rbuf + pos + cmd->writecnt, cmd->readcnt);
+			pos += cmd->writecnt + cmd->readcnt;
+		}
+		for (k = 0; k < count; k++) {
+			status[k] = reversed_bits[rbuf[pos + JEDEC_RDSR_OUTSIZE]];
+			pos += JEDEC_RDSR_OUTSIZE + JEDEC_RDSR_INSIZE;
+		}
+	}
+	free(seglen);
+	free(segread);
+	free(wbuf);
+	free(rbuf);
+	return ret < 0 ? -1 : 0;
+}
+
+/* Queue all commands at once like ch341a_spi_multicommand_poll(), unless a delay is too long for the device. */
+static int ch341a_spi_send_multicommand(struct flashctx *flash, struct spi_command *cmds)
+{
+	const int ret = ch341a_spi_multicommand_poll(flash, cmds, 0, 0, 0, NULL);
+
+	if (ret == SPI_INVALID_OPCODE)
+		return default_spi_send_multicommand(flash, cmds);
+	return ret;
+}
+
+/*
+ * Read len bytes with a single read command. The first OUT transfer holds the CS packet and the command, all
+ * further ones are SPI stream packets of dummy bytes from a buffer that is filled only once. Every IN transfer
+ * stays queued for the whole read, each one receiving the reply to one packet straight into buf.
+ */
+static int ch341a_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len)
+{
+	static uint8_t stream[CH341_MAX_PACKET_LEN];
+	uint8_t cmd[1 + JEDEC_MAX_ADDR_LEN + 1];
+	uint8_t head[2 * CH341_PACKET_LENGTH];
+	uint8_t echo[sizeof(cmd)];
+	int state_out = TRANS_IDLE;
+	int state_in[USB_IN_TRANSFERS] = {0};
+	/* IN transfer 0 receives the echo of the command, transfer k > 0 the reply to the k-th stream packet. */
+	const unsigned int in_total = 1 + (len + CH341_PACKET_LENGTH - 2) / (CH341_PACKET_LENGTH - 1);
+	unsigned int in_next = 0, in_done = 0, out_sent = 0, p;
+	int writecnt, ret;
+
+	if (handle == NULL)
+		return -1;
+	if (!len)
+		return 0;
+	writecnt = spi_prepare_read(flash, cmd, start);
+	if (writecnt < 0)
+		return 1;
+
+	memset(head, 0, sizeof(head));
+	pluck_cs(head);
+	fill_spi_stream(head + CH341_PACKET_LENGTH, writecnt, 0, cmd);
+	for (p = 0; p < CH341_MAX_PACKETS; p++) {
+		stream[p * CH341_PACKET_LENGTH] = CH341A_CMD_SPI_STREAM;
+		memset(stream + p * CH341_PACKET_LENGTH + 1, 0xFF, CH341_PACKET_LENGTH - 1);
+	}
+
+	transfer_out->buffer = head;
+	transfer_out->length = CH341_PACKET_LENGTH + 1 + writecnt;
+	transfer_out->user_data = &state_out;
+	state_out = TRANS_ACTIVE;
+	ret = libusb_submit_transfer(transfer_out);
+	if (ret) {
+		msg_perr("%s: failed to submit OUT transfer: %s\n", __func__, libusb_error_name(ret));
+		state_out = TRANS_ERR;
+		goto err;
+	}
+
+	/* transfer_out may complete only after the replies to its last packets arrived. */
+	while (in_done < in_total || state_out == TRANS_ACTIVE) {
+		/* Keep every IN transfer queued until the end of the read. */
+		while (in_next < in_total && state_in[in_next % USB_IN_TRANSFERS] == TRANS_IDLE) {
+			struct libusb_transfer *transfer = transfer_ins[in_next % USB_IN_TRANSFERS];
+			if (in_next) {
+				transfer->buffer = buf + (in_next - 1) * (CH341_PACKET_LENGTH - 1);
+				transfer->length = min(CH341_PACKET_LENGTH - 1,
+						       len - (in_next - 1) * (CH341_PACKET_LENGTH - 1));
+			} else {
+				transfer->buffer = echo;
+				transfer->length = writecnt;
+			}
+			transfer->user_data = &state_in[in_next % USB_IN_TRANSFERS];
+			ret = libusb_submit_transfer(transfer);
+			if (ret) {
+				msg_perr("%s: failed to submit IN transfer: %s\n", __func__, libusb_error_name(ret));
+				goto err;
+			}
+			state_in[in_next % USB_IN_TRANSFERS] = TRANS_ACTIVE;
+			in_next++;
+		}
+
+		libusb_handle_events_timeout(NULL, &(struct timeval){1, 0});
+
+		if (state_out == TRANS_ERR)
+			goto err;
+		/* The next batch of stream packets, the last one ends in a short packet. */
+		if (state_out > 0 && out_sent < len) {
+			const unsigned int data = min(CH341_MAX_PACKETS * (CH341_PACKET_LENGTH - 1), len - out_sent);
+			transfer_out->buffer = stream;
+			transfer_out->length = data + (data + CH341_PACKET_LENGTH - 2) / (CH341_PACKET_LENGTH - 1);
+			state_out = TRANS_ACTIVE;
+			ret = libusb_submit_transfer(transfer_out);
+			if (ret) {
+				msg_perr("%s: failed to submit OUT transfer: %s\n", __func__, libusb_error_name(ret));
+				state_out = TRANS_ERR;
+				goto err;
+			}
+			out_sent += data;
+		}
+
+		while (in_done < in_next && state_in[in_done % USB_IN_TRANSFERS] != TRANS_ACTIVE) {
+			struct libusb_transfer *transfer = transfer_ins[in_done % USB_IN_TRANSFERS];
+			if (state_in[in_done % USB_IN_TRANSFERS] != transfer->length) {
+				msg_perr("%s: short IN transfer\n", __func__);
+				goto err;
+			}
+			state_in[in_done % USB_IN_TRANSFERS] = TRANS_IDLE;
+			in_done++;
+		}
+	}
+
+	swap_bytes(buf, buf, len);
 	return 0;
+err:
+	msg_perr("%s: Failed to read %u bytes at 0x%06x\n", __func__, len, start);
+	cancel_transfers(&state_out, state_in);
+	return -1;
 }
 
 static const struct spi_master spi_master_ch341a_spi = {
@@ -404,9 +696,11 @@ static const struct spi_master spi_master_ch341a_spi = {
 	 * sent to the device and most of their payload streamed via SPI. */
 	.max_data_read	= 4 * 1024,
 	.max_data_write	= 4 * 1024,
+	.features	= SPI_MASTER_4BA,
 	.command	= ch341a_spi_spi_send_command,
-	.multicommand	= default_spi_send_multicommand,
-	.read		= default_spi_read,
+	.multicommand	= ch341a_spi_send_multicommand,
+	.multicommand_poll = ch341a_spi_multicommand_poll,
+	.read		= ch341a_spi_read,
 	.write_256	= default_spi_write_256,
 	.write_aai	= default_spi_write_aai,
 };
@@ -58,12 +58,37 @@ int spi_chip_write_1(struct flashctx *flash, const uint8_t *buf, unsigned int st
 int spi_byte_program(struct flashctx *flash, unsigned int addr, uint8_t databyte);
 int spi_nbyte_program(struct flashctx *flash, unsigned int addr, const uint8_t *bytes, unsigned int len);
 int spi_nbyte_read(struct flashctx *flash, unsigned int addr, uint8_t *bytes, unsigned int len);
+int spi_prepare_read(struct flashctx *flash, unsigned char *cmd, unsigned int address);
+unsigned int spi_max_read_khz(const struct flashctx *flash);
+int spi_read_multi_io(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len);
+bool spi_chip_4ba(const struct flashctx *flash);
+int spi_enter_4ba(struct flashctx *flash);
+int spi_exit_4ba(struct flashctx *flash);
 int spi_read_chunked(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len, unsigned int chunksize);
 int spi_write_chunked(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len, unsigned int chunksize);
 
 /* spi25_statusreg.c */
+enum spi_wait_op {
+	SPI_WAIT_BYTE_PROGRAM,
+	SPI_WAIT_PAGE_PROGRAM,
+	SPI_WAIT_PAGE_ERASE,
+	SPI_WAIT_SECTOR_ERASE,
+	SPI_WAIT_BLOCK_ERASE_52,
+	SPI_WAIT_BLOCK_ERASE_D7,
+	SPI_WAIT_BLOCK_ERASE_D8,
+	SPI_WAIT_CHIP_ERASE,
+	SPI_WAIT_DIE_ERASE,
+	SPI_WAIT_WRSR,
+	SPI_WAIT_IDLE,
+	SPI_WAIT_OP_COUNT
+};
+int spi_wait_ready(struct flashctx *flash, enum spi_wait_op op, unsigned int typ_us, unsigned int timeout_us);
+int spi_send_multicommand_wait(struct flashctx *flash, struct spi_command *cmds, enum spi_wait_op op,
+			       unsigned int typ_us, unsigned int timeout_us);
 uint8_t spi_read_status_register(struct flashctx *flash);
 int spi_write_status_register(struct flashctx *flash, int status);
+int spi_enable_quad_io(struct flashctx *flash);
+int spi_restore_quad_io(struct flashctx *flash);
 void spi_prettyprint_status_register_bit(uint8_t status, int bit);
 int spi_prettyprint_status_register_plain(struct flashctx *flash);
 int spi_prettyprint_status_register_default_welwip(struct flashctx *flash);
@@ -31,6 +31,13 @@
 #include "flashchips.h"
 #include "programmer.h"
 
+/* Values of options which only have a long form. */
+enum {
+	OPTION_VERIFY_BLOCKS = 0x0100,
+	OPTION_STREAM,
+	OPTION_QUAD_ENABLE,
+};
+
 static void cli_classic_usage(const char *name)
 {
 	printf("Please note that the command line interface for flashrom has changed between\n"
@@ -41,8 +48,8 @@ static void cli_classic_usage(const char *name)
 	       "-z|"
 #endif
 	       "-p <programmername>[:<parameters>] [-c <chipname>]\n"
-	       "[-E|(-r|-w|-v) <file>] [-l <layoutfile> [-i <imagename>]...] [-n] [-f]]\n"
-	       "[-V[V[V]]] [-o <logfile>]\n\n", name);
+	       "[-E|(-r|-w|-v) <file>] [-l <layoutfile> [-i <imagename>]...] [-n|--verify-blocks] [--stream] [-f]]\n"
+	       "[--quad-enable] [-V[V[V]]] [-o <logfile>]\n\n", name);
 
 	printf(" -h | --help                        print this help text\n"
 	       " -R | --version                     print version (release)\n"
@@ -54,6 +61,9 @@ static void cli_classic_usage(const char *name)
 	       " -c | --chip <chipname>             probe only for specified flash chip\n"
 	       " -f | --force                       force specific operations (see man page)\n"
 	       " -n | --noverify                    don't auto-verify\n"
+	       "      --verify-blocks               verify each erase block right after writing it\n"
+	       "      --stream                      write block by block with little memory\n"
+	       "      --quad-enable                 allow setting the Quad Enable bit for quad I/O\n"
 	       " -l | --layout <layoutfile>         read ROM layout from <layoutfile>\n"
 	       " -i | --image <name>                only flash image <name> from flash layout\n"
 	       " -o | --output <logfile>            log output to <logfile>\n"
@@ -103,6 +113,7 @@ int main(int argc, char *argv[])
 #endif
 	int read_it = 0, write_it = 0, erase_it = 0, verify_it = 0;
 	int dont_verify_it = 0, list_supported = 0, operation_specified = 0;
+	int verify_blocks = 0, stream = 0, quad_enable = 0;
 	enum programmer prog = PROGRAMMER_INVALID;
 	int ret = 0;
 
@@ -113,6 +124,9 @@ int main(int argc, char *argv[])
 		{"erase",		0, NULL, 'E'},
 		{"verify",		1, NULL, 'v'},
 		{"noverify",		0, NULL, 'n'},
+		{"verify-blocks",	0, NULL, OPTION_VERIFY_BLOCKS},
+		{"stream",		0, NULL, OPTION_STREAM},
+		{"quad-enable",		0, NULL, OPTION_QUAD_ENABLE},
 		{"chip",		1, NULL, 'c'},
 		{"verbose",		0, NULL, 'V'},
 		{"force",		0, NULL, 'f'},
@@ -187,6 +201,15 @@ int main(int argc, char *argv[])
 			}
 			dont_verify_it = 1;
 			break;
+		case OPTION_VERIFY_BLOCKS:
+			verify_blocks = 1;
+			break;
+		case OPTION_STREAM:
+			stream = 1;
+			break;
+		case OPTION_QUAD_ENABLE:
+			quad_enable = 1;
+			break;
 		case 'c':
 			chip_to_probe = strdup(optarg);
 			break;
@@ -326,6 +349,11 @@ int main(int argc, char *argv[])
 		cli_classic_abort_usage();
 	}
 
+	if (verify_blocks && dont_verify_it) {
+		fprintf(stderr, "--verify-blocks and --noverify are mutually exclusive. Aborting.\n");
+		cli_classic_abort_usage();
+	}
+
 	if ((read_it | write_it | verify_it) && check_filename(filename, "image")) {
 		cli_classic_abort_usage();
 	}
@@ -530,6 +558,10 @@ int main(int argc, char *argv[])
 	/* Always verify write operations unless -n is used. */
 	if (write_it && !dont_verify_it)
 		verify_it = 1;
+	/* Streaming keeps no image to verify against afterwards, hence it always verifies block by block. */
+	fill_flash->flags.verify_blocks = (verify_blocks || stream) && write_it && verify_it;
+	fill_flash->flags.stream = stream && write_it;
+	fill_flash->flags.quad_enable = quad_enable;
 
 	/* Map the selected flash chip again. */
 	if (map_flash(fill_flash) != 0) {
@@ -197,7 +197,17 @@ static void LIBUSB_CALL dediprog_bulk_read_cb(struct libusb_transfer *const tran
 	++status->finished_idx;
 }
 
-static int dediprog_bulk_read_poll(const struct dediprog_transfer_status *const status, const int finish)
+static void LIBUSB_CALL dediprog_bulk_write_cb(struct libusb_transfer *const transfer)
+{
+	struct dediprog_transfer_status *const status = (struct dediprog_transfer_status *)transfer->user_data;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED || transfer->actual_length != transfer->length) {
+		status->error = 1;
+		msg_perr("SPI bulk write failed!\n");
+	}
+	++status->finished_idx;
+}
+
+static int dediprog_bulk_poll(const struct dediprog_transfer_status *const status, const int finish)
 {
 	if (status->finished_idx >= status->queued_idx)
 		return 0;
@@ -206,7 +216,7 @@ static int dediprog_bulk_read_poll(const struct dediprog_transfer_status *const
 		struct timeval timeout = { 10, 0 };
 		const int ret = libusb_handle_events_timeout(usb_ctx, &timeout);
 		if (ret < 0) {
-			msg_perr("Polling read events failed: %i %s!\n", ret, libusb_error_name(ret));
+			msg_perr("Polling transfer events failed: %i %s!\n", ret, libusb_error_name(ret));
 			return 1;
 		}
 	} while (finish && (status->finished_idx < status->queued_idx));
@@ -462,7 +472,8 @@ static int dediprog_spi_bulk_read(struct flashctx *flash, uint8_t *buf, unsigned
 
 	/* Now transfer requested chunks using libusb's asynchronous interface. */
 	while (!status.error && (status.queued_idx < count)) {
-		while ((status.queued_idx - status.finished_idx) < DEDIPROG_ASYNC_TRANSFERS) {
+		while ((status.queued_idx < count) &&
+		       (status.queued_idx - status.finished_idx) < DEDIPROG_ASYNC_TRANSFERS) {
 			transfer = transfers[status.queued_idx % DEDIPROG_ASYNC_TRANSFERS];
 			libusb_fill_bulk_transfer(transfer, dediprog_handle, 0x80 | dediprog_in_endpoint,
 					(unsigned char *)buf + status.queued_idx * chunksize, chunksize,
@@ -476,11 +487,11 @@ static int dediprog_spi_bulk_read(struct flashctx *flash, uint8_t *buf, unsigned
 			}
 			++status.queued_idx;
 		}
-		if (dediprog_bulk_read_poll(&status, 0))
+		if (dediprog_bulk_poll(&status, 0))
 			goto err_free;
 	}
 	/* Wait for transfers to finish. */
-	if (dediprog_bulk_read_poll(&status, 1))
+	if (dediprog_bulk_poll(&status, 1))
 		goto err_free;
 	/* Check if everything has been transmitted. */
 	if ((status.finished_idx < count) || status.error)
@@ -489,7 +500,7 @@ static int dediprog_spi_bulk_read(struct flashctx *flash, uint8_t *buf, unsigned
 	err = 0;
 
 err_free:
-	dediprog_bulk_read_poll(&status, 1);
+	dediprog_bulk_poll(&status, 1);
 	for (i = 0; i < DEDIPROG_ASYNC_TRANSFERS; ++i)
 		if (transfers[i]) libusb_free_transfer(transfers[i]);
 	return err;
@@ -552,6 +563,12 @@ static int dediprog_spi_bulk_write(struct flashctx *flash, const uint8_t *buf, u
 	 */
 	const unsigned int count = len / chunksize;
 
+	struct dediprog_transfer_status status = { 0, 0, 0 };
+	struct libusb_transfer *transfers[DEDIPROG_ASYNC_TRANSFERS] = { NULL, };
+	struct libusb_transfer *transfer;
+	unsigned char usbbufs[DEDIPROG_ASYNC_TRANSFERS][512];
+	int err = 1;
+
 	/*
 	 * We should change this check to
 	 *   chunksize > 512
@@ -583,21 +600,50 @@ static int dediprog_spi_bulk_write(struct flashctx *flash, const uint8_t *buf, u
 		return 1;
 	}
 
+	/* Same ring buffer of bulk transfers as in dediprog_spi_bulk_read(), each with a packet buffer of its own. */
 	unsigned int i;
-	for (i = 0; i < count; i++) {
-		unsigned char usbbuf[512];
-		memcpy(usbbuf, buf + i * chunksize, chunksize);
-		memset(usbbuf + chunksize, 0xff, sizeof(usbbuf) - chunksize); // fill up with 0xFF
-		int transferred;
-		ret = libusb_bulk_transfer(dediprog_handle, dediprog_out_endpoint, usbbuf, 512, &transferred,
-					   DEFAULT_TIMEOUT);
-		if ((ret < 0) || (transferred != 512)) {
-			msg_perr("SPI bulk write failed, expected %i, got %s!\n", 512, libusb_error_name(ret));
-			return 1;
+	for (i = 0; i < min(DEDIPROG_ASYNC_TRANSFERS, count); ++i) {
+		transfers[i] = libusb_alloc_transfer(0);
+		if (!transfers[i]) {
+			msg_perr("Allocating libusb transfer %i failed!\n", i);
+			goto err_free;
 		}
 	}
 
-	return 0;
+	while (!status.error && (status.queued_idx < count)) {
+		while ((status.queued_idx < count) &&
+		       (status.queued_idx - status.finished_idx) < DEDIPROG_ASYNC_TRANSFERS) {
+			unsigned char *const usbbuf = usbbufs[status.queued_idx % DEDIPROG_ASYNC_TRANSFERS];
+			memcpy(usbbuf, buf + status.queued_idx * chunksize, chunksize);
+			memset(usbbuf + chunksize, 0xff, 512 - chunksize); // fill up with 0xFF
+			transfer = transfers[status.queued_idx % DEDIPROG_ASYNC_TRANSFERS];
+			libusb_fill_bulk_transfer(transfer, dediprog_handle, dediprog_out_endpoint, usbbuf, 512,
+					dediprog_bulk_write_cb, &status, DEFAULT_TIMEOUT);
+			ret = libusb_submit_transfer(transfer);
+			if (ret < 0) {
+				msg_perr("Submitting SPI bulk write %i failed: %s!\n",
+					 status.queued_idx, libusb_error_name(ret));
+				goto err_free;
+			}
+			++status.queued_idx;
+		}
+		if (dediprog_bulk_poll(&status, 0))
+			goto err_free;
+	}
+	/* Wait for transfers to finish. */
+	if (dediprog_bulk_poll(&status, 1))
+		goto err_free;
+	/* Check if everything has been transmitted. */
+	if ((status.finished_idx < count) || status.error)
+		goto err_free;
+
+	err = 0;
+
+err_free:
+	dediprog_bulk_poll(&status, 1);
+	for (i = 0; i < DEDIPROG_ASYNC_TRANSFERS; ++i)
+		if (transfers[i]) libusb_free_transfer(transfers[i]);
+	return err;
 }
 
 static int dediprog_spi_write(struct flashctx *flash, const uint8_t *buf,
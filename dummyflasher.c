@@ -47,6 +47,8 @@ enum emu_chip {
 	EMULATE_SST_SST25VF040_REMS,
 	EMULATE_SST_SST25VF032B,
 	EMULATE_MACRONIX_MX25L6436,
+	EMULATE_MACRONIX_MX25L25635,
+	EMULATE_WINBOND_W25Q256FV,
 };
 static enum emu_chip emu_chip = EMULATE_NONE;
 static char *emu_persistent_image = NULL;
@@ -64,6 +66,17 @@ unsigned char spi_ignorelist[256];
 int spi_blacklist_size = 0;
 int spi_ignorelist_size = 0;
 static uint8_t emu_status = 0;
+static bool emu_4ba_mode = false;
+
+/* Native 4-byte address opcodes and the 3-byte address commands they correspond to. */
+static const uint8_t emu_4ba_opcodes[][2] = {
+	{ JEDEC_READ_4BA, JEDEC_READ },
+	{ JEDEC_FAST_READ_4BA, JEDEC_FAST_READ },
+	{ JEDEC_BYTE_PROGRAM_4BA, JEDEC_BYTE_PROGRAM },
+	{ JEDEC_SE_4BA, JEDEC_SE },
+	{ JEDEC_BE_5C, JEDEC_BE_52 },
+	{ JEDEC_BE_DC, JEDEC_BE_D8 },
+};
 
 /* A legit complete SFDP table based on the MX25L6436E (rev. 1.8) datasheet. */
 static const uint8_t sfdp_table[] = {
@@ -95,11 +108,29 @@ static const uint8_t sfdp_table[] = {
 #endif
 
 static unsigned int spi_write_256_chunksize = 256;
+/* SPI clock cycles of all commands sent, to compare the bus time of different command sequences. */
+static unsigned long long spi_bus_clocks = 0;
+/* Calls into the master, i.e. what would be a USB transfer on real programmers. */
+static unsigned long long spi_bus_transactions = 0;
+/* Requests submitted but not executed yet, oldest first. A full queue executes its oldest request. */
+#define DUMMY_SPI_QUEUE_LEN 16
+static struct spi_async *spi_queue[DUMMY_SPI_QUEUE_LEN];
+static unsigned int spi_queue_head = 0;
+static unsigned int spi_queue_count = 0;
 
 static int dummy_spi_send_command(struct flashctx *flash, unsigned int writecnt, unsigned int readcnt,
 				  const unsigned char *writearr, unsigned char *readarr);
+static int dummy_spi_multicommand_poll(struct flashctx *flash, struct spi_command *cmds, unsigned int delay_us,
+				       unsigned int step_us, unsigned int count, uint8_t *status);
+static int dummy_spi_submit(struct flashctx *flash, struct spi_async *req);
+static void dummy_spi_complete(struct flashctx *flash, struct spi_async *req, bool wait);
+static void dummy_spi_flush(void);
 static int dummy_spi_write_256(struct flashctx *flash, const uint8_t *buf,
 			       unsigned int start, unsigned int len);
+static int dummy_spi_read_multi_io(struct flashctx *flash, const struct spi_multi_io_read *cmd, uint8_t *buf,
+				   unsigned int len);
+static int dummy_spi_write_multi_io(struct flashctx *flash, const struct spi_multi_io_write *cmd,
+				    const uint8_t *buf, unsigned int len);
 static void dummy_chip_writeb(const struct flashctx *flash, uint8_t val, chipaddr addr);
 static void dummy_chip_writew(const struct flashctx *flash, uint16_t val, chipaddr addr);
 static void dummy_chip_writel(const struct flashctx *flash, uint32_t val, chipaddr addr);
@@ -109,13 +140,19 @@ static uint16_t dummy_chip_readw(const struct flashctx *flash, const chipaddr ad
 static uint32_t dummy_chip_readl(const struct flashctx *flash, const chipaddr addr);
 static void dummy_chip_readn(const struct flashctx *flash, uint8_t *buf, const chipaddr addr, size_t len);
 
-static const struct spi_master spi_master_dummyflasher = {
+static struct spi_master spi_master_dummyflasher = {
 	.type		= SPI_CONTROLLER_DUMMY,
 	.max_data_read	= MAX_DATA_READ_UNLIMITED,
 	.max_data_write	= MAX_DATA_UNSPECIFIED,
+	.features	= SPI_MASTER_4BA,
 	.command	= dummy_spi_send_command,
 	.multicommand	= default_spi_send_multicommand,
+	.multicommand_poll = dummy_spi_multicommand_poll,
+	.submit		= dummy_spi_submit,
+	.complete	= dummy_spi_complete,
 	.read		= default_spi_read,
+	.read_multi_io	= dummy_spi_read_multi_io,
+	.write_multi_io	= dummy_spi_write_multi_io,
 	.write_256	= dummy_spi_write_256,
 	.write_aai	= default_spi_write_aai,
 };
@@ -137,6 +174,10 @@ enum chipbustype dummy_buses_supported = BUS_NONE;
 static int dummy_shutdown(void *data)
 {
 	msg_pspew("%s\n", __func__);
+	dummy_spi_flush();
+	if (spi_bus_clocks)
+		msg_pdbg("SPI bus time: %llu clock cycles in %llu transactions.\n", spi_bus_clocks,
+			 spi_bus_transactions);
 #if EMULATE_CHIP
 	if (emu_chip != EMULATE_NONE) {
 		if (emu_persistent_image) {
@@ -203,6 +244,12 @@ int dummy_init(void)
 		}
 	}
 
+	tmp = extract_programmer_param("spispeed");
+	if (tmp) {
+		spi_master_dummyflasher.clock_khz = atoi(tmp);
+		free(tmp);
+	}
+
 	tmp = extract_programmer_param("spi_blacklist");
 	if (tmp) {
 		i = strlen(tmp);
@@ -335,6 +382,32 @@ int dummy_init(void)
 		msg_pdbg("Emulating Macronix MX25L6436 SPI flash chip (RDID, "
 			 "SFDP)\n");
 	}
+	if (!strcmp(tmp, "MX25L25635")) {
+		emu_chip = EMULATE_MACRONIX_MX25L25635;
+		emu_chip_size = 32 * 1024 * 1024;
+		emu_max_byteprogram_size = 256;
+		emu_max_aai_size = 0;
+		emu_jedec_se_size = 4 * 1024;
+		emu_jedec_be_52_size = 32 * 1024;
+		emu_jedec_be_d8_size = 64 * 1024;
+		emu_jedec_ce_60_size = emu_chip_size;
+		emu_jedec_ce_c7_size = emu_chip_size;
+		msg_pdbg("Emulating Macronix MX25L25635 SPI flash chip (RDID, "
+			 "4-byte addressing)\n");
+	}
+	if (!strcmp(tmp, "W25Q256FV")) {
+		emu_chip = EMULATE_WINBOND_W25Q256FV;
+		emu_chip_size = 32 * 1024 * 1024;
+		emu_max_byteprogram_size = 256;
+		emu_max_aai_size = 0;
+		emu_jedec_se_size = 4 * 1024;
+		emu_jedec_be_52_size = 32 * 1024;
+		emu_jedec_be_d8_size = 64 * 1024;
+		emu_jedec_ce_60_size = emu_chip_size;
+		emu_jedec_ce_c7_size = emu_chip_size;
+		msg_pdbg("Emulating Winbond W25Q256FV SPI flash chip (RDID, "
+			 "4-byte address mode only)\n");
+	}
 #endif
 	if (emu_chip == EMULATE_NONE) {
 		msg_perr("Invalid chip specified for emulation: %s\n", tmp);
@@ -363,6 +436,19 @@ int dummy_init(void)
 		msg_pdbg("Initial status register is set to 0x%02x.\n",
 			 emu_status);
 	}
+
+	tmp = extract_programmer_param("spi_multi_io");
+	if (tmp) {
+		if (strstr(tmp, "1-1-2"))
+			spi_master_dummyflasher.io_modes |= SPI_IO_1_1_2;
+		if (strstr(tmp, "1-2-2"))
+			spi_master_dummyflasher.io_modes |= SPI_IO_1_2_2;
+		if (strstr(tmp, "1-1-4"))
+			spi_master_dummyflasher.io_modes |= SPI_IO_1_1_4;
+		if (strstr(tmp, "1-4-4"))
+			spi_master_dummyflasher.io_modes |= SPI_IO_1_4_4;
+		free(tmp);
+	}
 #endif
 
 	msg_pdbg("Filling fake flash chip with 0xff, size %i\n", emu_chip_size);
@@ -468,16 +554,28 @@ static void dummy_chip_readn(const struct flashctx *flash, uint8_t *buf, const c
 }
 
 #if EMULATE_SPI_CHIP
+static unsigned int emu_get_address(const unsigned char *writearr, unsigned int addr_len)
+{
+	unsigned int addr = 0, i;
+
+	for (i = 1; i <= addr_len; i++)
+		addr = addr << 8 | writearr[i];
+	return addr;
+}
+
 static int emulate_spi_chip_response(unsigned int writecnt,
 				     unsigned int readcnt,
 				     const unsigned char *writearr,
 				     unsigned char *readarr)
 {
-	unsigned int offs, i, toread;
+	unsigned int offs, i, toread, addr_len;
 	static int unsigned aai_offs;
+	uint8_t opcode;
 	const unsigned char sst25vf040_rems_response[2] = {0xbf, 0x44};
 	const unsigned char sst25vf032b_rems_response[2] = {0xbf, 0x4a};
 	const unsigned char mx25l6436_rems_response[2] = {0xc2, 0x16};
+	const unsigned char mx25l25635_rems_response[2] = {0xc2, 0x18};
+	const unsigned char w25q256fv_rems_response[2] = {0xef, 0x18};
 
 	if (writecnt == 0) {
 		msg_perr("No command sent to the chip!\n");
@@ -512,7 +610,22 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		}
 	}
 
-	switch (writearr[0]) {
+	/* Commands with native 4-byte addresses behave like their 3-byte address counterparts. The W25Q256FV
+	 * emulation lacks them and can only reach the upper 16 MiB in 4-byte address mode.
+	 */
+	opcode = writearr[0];
+	addr_len = emu_4ba_mode ? 4 : 3;
+	if (emu_chip == EMULATE_MACRONIX_MX25L25635) {
+		for (i = 0; i < ARRAY_SIZE(emu_4ba_opcodes); i++) {
+			if (opcode == emu_4ba_opcodes[i][0]) {
+				opcode = emu_4ba_opcodes[i][1];
+				addr_len = 4;
+				break;
+			}
+		}
+	}
+
+	switch (opcode) {
 	case JEDEC_RES:
 		if (writecnt < JEDEC_RES_OUTSIZE)
 			break;
@@ -536,6 +649,11 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 			if (readcnt > 0)
 				memset(readarr, 0x16, readcnt);
 			break;
+		case EMULATE_MACRONIX_MX25L25635:
+		case EMULATE_WINBOND_W25Q256FV:
+			if (readcnt > 0)
+				memset(readarr, 0x18, readcnt);
+			break;
 		default: /* ignore */
 			break;
 		}
@@ -559,6 +677,14 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 			for (i = 0; i < readcnt; i++)
 				readarr[i] = mx25l6436_rems_response[(offs + i) % 2];
 			break;
+		case EMULATE_MACRONIX_MX25L25635:
+			for (i = 0; i < readcnt; i++)
+				readarr[i] = mx25l25635_rems_response[(offs + i) % 2];
+			break;
+		case EMULATE_WINBOND_W25Q256FV:
+			for (i = 0; i < readcnt; i++)
+				readarr[i] = w25q256fv_rems_response[(offs + i) % 2];
+			break;
 		default: /* ignore */
 			break;
 		}
@@ -581,6 +707,22 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 			if (readcnt > 2)
 				readarr[2] = 0x17;
 			break;
+		case EMULATE_MACRONIX_MX25L25635:
+			if (readcnt > 0)
+				readarr[0] = 0xc2;
+			if (readcnt > 1)
+				readarr[1] = 0x20;
+			if (readcnt > 2)
+				readarr[2] = 0x19;
+			break;
+		case EMULATE_WINBOND_W25Q256FV:
+			if (readcnt > 0)
+				readarr[0] = 0xef;
+			if (readcnt > 1)
+				readarr[1] = 0x40;
+			if (readcnt > 2)
+				readarr[2] = 0x19;
+			break;
 		default: /* ignore */
 			break;
 		}
@@ -602,26 +744,42 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		emu_status = writearr[1] & ~SPI_SR_WIP;
 		msg_pdbg2("WRSR wrote 0x%02x.\n", emu_status);
 		break;
+	case JEDEC_ENTER_4_BYTE_ADDR_MODE:
+	case JEDEC_EXIT_4_BYTE_ADDR_MODE:
+		if (emu_chip != EMULATE_MACRONIX_MX25L25635 && emu_chip != EMULATE_WINBOND_W25Q256FV)
+			break;
+		emu_4ba_mode = opcode == JEDEC_ENTER_4_BYTE_ADDR_MODE;
+		msg_pdbg2("%s 4-byte address mode.\n", emu_4ba_mode ? "Entered" : "Left");
+		break;
 	case JEDEC_READ:
-		offs = writearr[1] << 16 | writearr[2] << 8 | writearr[3];
+	case JEDEC_FAST_READ:
+		if (writecnt < 1 + addr_len) {
+			msg_perr("READ address too short!\n");
+			return 1;
+		}
+		if (opcode == JEDEC_FAST_READ && writecnt < 2 + addr_len) {
+			msg_perr("FAST READ without dummy byte!\n");
+			return 1;
+		}
+		offs = emu_get_address(writearr, addr_len);
 		/* Truncate to emu_chip_size. */
 		offs %= emu_chip_size;
 		if (readcnt > 0)
 			memcpy(readarr, flashchip_contents + offs, readcnt);
 		break;
 	case JEDEC_BYTE_PROGRAM:
-		offs = writearr[1] << 16 | writearr[2] << 8 | writearr[3];
-		/* Truncate to emu_chip_size. */
-		offs %= emu_chip_size;
-		if (writecnt < 5) {
+		if (writecnt < 2 + addr_len) {
 			msg_perr("BYTE PROGRAM size too short!\n");
 			return 1;
 		}
-		if (writecnt - 4 > emu_max_byteprogram_size) {
+		offs = emu_get_address(writearr, addr_len);
+		/* Truncate to emu_chip_size. */
+		offs %= emu_chip_size;
+		if (writecnt - 1 - addr_len > emu_max_byteprogram_size) {
 			msg_perr("Max BYTE PROGRAM size exceeded!\n");
 			return 1;
 		}
-		memcpy(flashchip_contents + offs, writearr + 4, writecnt - 4);
+		memcpy(flashchip_contents + offs, writearr + 1 + addr_len, writecnt - 1 - addr_len);
 		break;
 	case JEDEC_AAI_WORD_PROGRAM:
 		if (!emu_max_aai_size)
@@ -666,7 +824,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 	case JEDEC_SE:
 		if (!emu_jedec_se_size)
 			break;
-		if (writecnt != JEDEC_SE_OUTSIZE) {
+		if (writecnt != JEDEC_SE_OUTSIZE + addr_len - 3) {
 			msg_perr("SECTOR ERASE 0x20 outsize invalid!\n");
 			return 1;
 		}
@@ -674,7 +832,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 			msg_perr("SECTOR ERASE 0x20 insize invalid!\n");
 			return 1;
 		}
-		offs = writearr[1] << 16 | writearr[2] << 8 | writearr[3];
+		offs = emu_get_address(writearr, addr_len) % emu_chip_size;
 		if (offs & (emu_jedec_se_size - 1))
 			msg_pdbg("Unaligned SECTOR ERASE 0x20: 0x%x\n", offs);
 		offs &= ~(emu_jedec_se_size - 1);
@@ -683,7 +841,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 	case JEDEC_BE_52:
 		if (!emu_jedec_be_52_size)
 			break;
-		if (writecnt != JEDEC_BE_52_OUTSIZE) {
+		if (writecnt != JEDEC_BE_52_OUTSIZE + addr_len - 3) {
 			msg_perr("BLOCK ERASE 0x52 outsize invalid!\n");
 			return 1;
 		}
@@ -691,7 +849,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 			msg_perr("BLOCK ERASE 0x52 insize invalid!\n");
 			return 1;
 		}
-		offs = writearr[1] << 16 | writearr[2] << 8 | writearr[3];
+		offs = emu_get_address(writearr, addr_len) % emu_chip_size;
 		if (offs & (emu_jedec_be_52_size - 1))
 			msg_pdbg("Unaligned BLOCK ERASE 0x52: 0x%x\n", offs);
 		offs &= ~(emu_jedec_be_52_size - 1);
@@ -700,7 +858,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 	case JEDEC_BE_D8:
 		if (!emu_jedec_be_d8_size)
 			break;
-		if (writecnt != JEDEC_BE_D8_OUTSIZE) {
+		if (writecnt != JEDEC_BE_D8_OUTSIZE + addr_len - 3) {
 			msg_perr("BLOCK ERASE 0xd8 outsize invalid!\n");
 			return 1;
 		}
@@ -708,7 +866,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 			msg_perr("BLOCK ERASE 0xd8 insize invalid!\n");
 			return 1;
 		}
-		offs = writearr[1] << 16 | writearr[2] << 8 | writearr[3];
+		offs = emu_get_address(writearr, addr_len) % emu_chip_size;
 		if (offs & (emu_jedec_be_d8_size - 1))
 			msg_pdbg("Unaligned BLOCK ERASE 0xd8: 0x%x\n", offs);
 		offs &= ~(emu_jedec_be_d8_size - 1);
@@ -783,16 +941,14 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		/* No special response. */
 		break;
 	}
-	if (writearr[0] != JEDEC_WREN && writearr[0] != JEDEC_EWSR)
+	if (opcode != JEDEC_WREN && opcode != JEDEC_EWSR)
 		emu_status &= ~SPI_SR_WEL;
 	return 0;
 }
 #endif
 
-static int dummy_spi_send_command(struct flashctx *flash, unsigned int writecnt,
-				  unsigned int readcnt,
-				  const unsigned char *writearr,
-				  unsigned char *readarr)
+static int dummy_spi_transfer(unsigned int writecnt, unsigned int readcnt, const unsigned char *writearr,
+			      unsigned char *readarr)
 {
 	int i;
 
@@ -801,6 +957,7 @@ static int dummy_spi_send_command(struct flashctx *flash, unsigned int writecnt,
 	msg_pspew(" writing %u bytes:", writecnt);
 	for (i = 0; i < writecnt; i++)
 		msg_pspew(" 0x%02x", writearr[i]);
+	spi_bus_clocks += (writecnt + readcnt) * 8;
 
 	/* Response for unknown commands and missing chip is 0xff. */
 	memset(readarr, 0xff, readcnt);
@@ -810,6 +967,8 @@ static int dummy_spi_send_command(struct flashctx *flash, unsigned int writecnt,
 	case EMULATE_SST_SST25VF040_REMS:
 	case EMULATE_SST_SST25VF032B:
 	case EMULATE_MACRONIX_MX25L6436:
+	case EMULATE_MACRONIX_MX25L25635:
+	case EMULATE_WINBOND_W25Q256FV:
 		if (emulate_spi_chip_response(writecnt, readcnt, writearr,
 					      readarr)) {
 			msg_pdbg("Invalid command sent to flash chip!\n");
@@ -827,8 +986,201 @@ static int dummy_spi_send_command(struct flashctx *flash, unsigned int writecnt,
 	return 0;
 }
 
+/* Execute cmds as a single bus transaction. */
+static int dummy_spi_run(struct spi_command *cmds)
+{
+	spi_bus_transactions++;
+	for (; cmds->writecnt || cmds->readcnt; cmds++) {
+		if (dummy_spi_transfer(cmds->writecnt, cmds->readcnt, cmds->writearr, cmds->readarr))
+			return 1;
+		if (cmds->delay_us)
+			programmer_delay(cmds->delay_us);
+	}
+	return 0;
+}
+
+static void dummy_spi_complete_oldest(void)
+{
+	struct spi_async *req = spi_queue[spi_queue_head];
+
+	req->result = dummy_spi_run(req->cmds);
+	req->done = true;
+	spi_queue_head = (spi_queue_head + 1) % DUMMY_SPI_QUEUE_LEN;
+	spi_queue_count--;
+}
+
+static void dummy_spi_flush(void)
+{
+	while (spi_queue_count)
+		dummy_spi_complete_oldest();
+}
+
+static int dummy_spi_submit(struct flashctx *flash, struct spi_async *req)
+{
+	if (spi_queue_count == DUMMY_SPI_QUEUE_LEN)
+		dummy_spi_complete_oldest();
+	spi_queue[(spi_queue_head + spi_queue_count) % DUMMY_SPI_QUEUE_LEN] = req;
+	spi_queue_count++;
+	return 0;
+}
+
+/* Without wait, one request finishes per call to mimic a bus that is busy in the background. */
+static void dummy_spi_complete(struct flashctx *flash, struct spi_async *req, bool wait)
+{
+	if (!wait) {
+		if (spi_queue_count)
+			dummy_spi_complete_oldest();
+		return;
+	}
+	while (!req->done && spi_queue_count)
+		dummy_spi_complete_oldest();
+}
+
+static int dummy_spi_send_command(struct flashctx *flash, unsigned int writecnt,
+				  unsigned int readcnt,
+				  const unsigned char *writearr,
+				  unsigned char *readarr)
+{
+	dummy_spi_flush();
+	spi_bus_transactions++;
+	return dummy_spi_transfer(writecnt, readcnt, writearr, readarr);
+}
+
+static int dummy_spi_multicommand_poll(struct flashctx *flash, struct spi_command *cmds, unsigned int delay_us,
+				       unsigned int step_us, unsigned int count, uint8_t *status)
+{
+	static const unsigned char cmd_rdsr[JEDEC_RDSR_OUTSIZE] = { JEDEC_RDSR };
+	unsigned int i;
+
+	dummy_spi_flush();
+	if (dummy_spi_run(cmds))
+		return 1;
+	for (i = 0; i < count; i++) {
+		programmer_delay(i ? step_us : delay_us);
+		if (dummy_spi_transfer(sizeof(cmd_rdsr), JEDEC_RDSR_INSIZE, cmd_rdsr, &status[i]))
+			return 1;
+	}
+	return 0;
+}
+
 static int dummy_spi_write_256(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
 {
 	return spi_write_chunked(flash, buf, start, len,
 				 spi_write_256_chunksize);
 }
+
+/* Clock cycles of a multi I/O command. The opcode is always sent on one line. */
+static unsigned long long dummy_multi_io_clocks(unsigned int io_mode, unsigned int addr_len,
+						unsigned int dummy_clocks, unsigned int len)
+{
+	unsigned int addr_lines = 1, data_lines = 4;
+
+	if (io_mode & SPI_IO_1_2_2)
+		addr_lines = 2;
+	else if (io_mode & SPI_IO_1_4_4)
+		addr_lines = 4;
+	if (io_mode & (SPI_IO_1_1_2 | SPI_IO_1_2_2))
+		data_lines = 2;
+	return 8 + addr_len * 8 / addr_lines + dummy_clocks + (unsigned long long)len * 8 / data_lines;
+}
+
+static int dummy_spi_read_multi_io(struct flashctx *flash, const struct spi_multi_io_read *cmd, uint8_t *buf,
+				   unsigned int len)
+{
+#if EMULATE_SPI_CHIP
+	/* The reads of the MX25L6436 and their dummy clocks, which include the mode bits. */
+	static const struct {
+		unsigned int io_mode;
+		uint8_t opcode;
+		unsigned int dummy_clocks;
+	} reads[] = {
+		{ SPI_IO_1_1_2, JEDEC_READ_1_1_2, 8 },
+		{ SPI_IO_1_2_2, JEDEC_READ_1_2_2, 4 },
+		{ SPI_IO_1_1_4, JEDEC_READ_1_1_4, 8 },
+		{ SPI_IO_1_4_4, JEDEC_READ_1_4_4, 6 },
+	};
+	unsigned int offs, toread, i;
+
+	msg_pspew("%s: opcode 0x%02x, address 0x%06x, %u dummy clocks, reading %u bytes\n", __func__,
+		  cmd->opcode, cmd->addr, cmd->dummy_clocks, len);
+	dummy_spi_flush();
+	if (emu_chip != EMULATE_MACRONIX_MX25L6436)
+		return SPI_INVALID_OPCODE;
+	for (i = 0; i < ARRAY_SIZE(reads); i++)
+		if (cmd->io_mode == reads[i].io_mode && cmd->opcode == reads[i].opcode)
+			break;
+	if (i == ARRAY_SIZE(reads)) {
+		msg_perr("Unsupported multi I/O read 0x%02x!\n", cmd->opcode);
+		return SPI_INVALID_OPCODE;
+	}
+	/* Rejected modes never reach the bus, the caller falls back to a regular read. */
+	spi_bus_clocks += dummy_multi_io_clocks(cmd->io_mode, cmd->addr_len, cmd->dummy_clocks, len);
+	spi_bus_transactions++;
+	if (cmd->addr_len != 3) {
+		msg_perr("Wrong address length for 0x%02x!\n", cmd->opcode);
+		return 1;
+	}
+	if (cmd->dummy_clocks != reads[i].dummy_clocks) {
+		msg_perr("Wrong number of dummy clocks for 0x%02x!\n", cmd->opcode);
+		return 1;
+	}
+	if ((cmd->io_mode & (SPI_IO_1_1_4 | SPI_IO_1_4_4)) && !(emu_status & (1 << 6))) {
+		msg_perr("Quad read with the QE bit cleared!\n");
+		return 1;
+	}
+	/* Reads wrap around at the end of the chip. */
+	offs = cmd->addr % emu_chip_size;
+	while (len) {
+		toread = min(len, emu_chip_size - offs);
+		memcpy(buf, flashchip_contents + offs, toread);
+		buf += toread;
+		len -= toread;
+		offs = 0;
+	}
+	return 0;
+#else
+	return SPI_INVALID_OPCODE;
+#endif
+}
+
+static int dummy_spi_write_multi_io(struct flashctx *flash, const struct spi_multi_io_write *cmd,
+				    const uint8_t *buf, unsigned int len)
+{
+#if EMULATE_SPI_CHIP
+	unsigned int offs;
+
+	msg_pspew("%s: opcode 0x%02x, address 0x%06x, writing %u bytes\n", __func__, cmd->opcode, cmd->addr, len);
+	dummy_spi_flush();
+	/* The MX25L6436 supports the 1-4-4 Quad I/O Page Program (4PP). */
+	if (emu_chip != EMULATE_MACRONIX_MX25L6436)
+		return SPI_INVALID_OPCODE;
+	if (cmd->io_mode != SPI_IO_1_4_4 || cmd->opcode != JEDEC_PP_1_4_4) {
+		msg_perr("Unsupported quad page program 0x%02x!\n", cmd->opcode);
+		return SPI_INVALID_OPCODE;
+	}
+	spi_bus_clocks += dummy_multi_io_clocks(cmd->io_mode, cmd->addr_len, 0, len);
+	spi_bus_transactions++;
+	if (cmd->addr_len != 3) {
+		msg_perr("Wrong address length for 0x%02x!\n", cmd->opcode);
+		return 1;
+	}
+	if (!(emu_status & (1 << 6))) {
+		msg_perr("Quad page program with the QE bit cleared!\n");
+		return 1;
+	}
+	if (!(emu_status & SPI_SR_WEL)) {
+		msg_perr("Quad page program attempted, but WEL is 0!\n");
+		return 1;
+	}
+	if (len > emu_max_byteprogram_size) {
+		msg_perr("Max quad page program size exceeded!\n");
+		return 1;
+	}
+	offs = cmd->addr % emu_chip_size;
+	memcpy(flashchip_contents + offs, buf, len);
+	emu_status &= ~SPI_SR_WEL;
+	return 0;
+#else
+	return SPI_INVALID_OPCODE;
+#endif
+}
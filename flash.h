@@ -123,6 +123,22 @@ enum write_granularity {
 #define FEATURE_WRSR_EITHER	(FEATURE_WRSR_EWSR | FEATURE_WRSR_WREN)
 #define FEATURE_OTP		(1 << 8)
 #define FEATURE_QPI		(1 << 9)
+#define FEATURE_FAST_READ	(1 << 10)	/* Fast Read (0x0B) with one dummy byte */
+#define FEATURE_IO_1_1_2	(1 << 11)	/* Dual Output Read (0x3B) */
+#define FEATURE_IO_1_2_2	(1 << 12)	/* Dual I/O Read (0xBB) */
+#define FEATURE_IO_1_1_4	(1 << 13)	/* Quad Output Read (0x6B), needs a QE bit */
+#define FEATURE_IO_1_4_4	(1 << 14)	/* Quad I/O Read (0xEB), needs a QE bit */
+#define FEATURE_QE_SR1_BIT6	(1 << 15)	/* Quad Enable is bit 6 of the status register */
+#define FEATURE_QE_SR2_BIT1	(1 << 16)	/* Quad Enable is bit 1 of status register 2, written together with
+						 * status register 1 by WRSR */
+#define FEATURE_4BA_ENTER	(1 << 17)	/* Enter/exit 4-byte address mode with 0xB7/0xE9 */
+#define FEATURE_4BA_NATIVE	(1 << 18)	/* Native 4-byte address opcodes for read (0x13, 0x0C and the
+						 * multi I/O reads the chip supports), program (0x12) and erase
+						 * (0x21, 0x5C, 0xDC) */
+#define FEATURE_QE_NONE		(1 << 19)	/* Quad reads work without setting a Quad Enable bit */
+#define FEATURE_PP_1_1_4	(1 << 20)	/* Quad Input Page Program (0x32), needs a QE bit */
+#define FEATURE_PP_1_4_4	(1 << 21)	/* Quad I/O Page Program (0x38), needs a QE bit */
+#define FEATURE_AT45DB_BUFFER2	(1 << 22)	/* DataFlash with a second SRAM buffer (0x87, 0x89) */
 
 enum test_state {
 	OK = 0,
@@ -208,6 +224,25 @@ struct flashchip {
 		uint16_t max;
 	} voltage;
 	enum write_granularity gran;
+
+	/* Datasheet durations of self-timed operations in microseconds (0 if unknown) and the maximum SPI
+	 * clock of the plain Read (0x03) command in kHz (0 if unknown).
+	 */
+	struct chip_timing {
+		struct op_timing {
+			uint32_t typ;
+			uint32_t max;
+		} byte_program, page_program, sector_erase, block32_erase, block64_erase, chip_erase;
+		unsigned int max_read_khz;
+	} timing;
+
+	/* Opcode and dummy clocks (wait states plus mode clocks) of the 1-1-2, 1-2-2, 1-1-4 and 1-4-4 reads
+	 * (in this order) if they are known to differ from the defaults in spi25.c, all zero otherwise.
+	 */
+	struct spi_read_mode {
+		uint8_t opcode;
+		uint8_t dummy_clocks;
+	} multi_io_reads[4];
 };
 
 struct flashctx {
@@ -222,6 +257,29 @@ struct flashctx {
 	uintptr_t physical_registers;
 	chipaddr virtual_registers;
 	struct registered_master *mst;
+	struct {
+		/* Verify each erase block right after writing it instead of reading the whole chip again. */
+		bool verify_blocks;
+		/* Write one erase block at a time without holding whole images in memory. */
+		bool stream;
+		/* Quad I/O may set the (non-volatile) Quad Enable bit for the duration of the session. */
+		bool quad_enable;
+	} flags;
+	/* The chip was switched to 4-byte address mode with 0xB7. */
+	bool in_4ba_mode;
+	/* Quad I/O state of SPI chips, worked out on first use. */
+	struct {
+		bool checked;		/* usable is valid. */
+		bool usable;		/* The Quad Enable bit is set or not needed. */
+		bool read_checked;	/* read is valid. */
+		int read;		/* Multi I/O read to use, -1 for none. */
+		bool program_checked;	/* program is valid. */
+		int program;		/* Quad page program to use, -1 for none. */
+		/* The Quad Enable bit was set by us, sr holds the status registers to restore afterwards. */
+		bool restore;
+		uint8_t sr[2];
+		unsigned int sr_len;
+	} quad;
 };
 
 /* Timing used in probe routines. ZERO is -2 to differentiate between an unset
@@ -266,6 +324,14 @@ char* strtok_r(char *str, const char *delim, char **nextp);
 size_t strnlen(const char *str, size_t n);
 #endif
 
+/* memops.c */
+int mem_is_erased(const uint8_t *buf, unsigned int len);
+int mem_need_erase_bits(const uint8_t *have, const uint8_t *want, unsigned int len);
+int mem_need_erase_bytes(const uint8_t *have, const uint8_t *want, unsigned int len);
+unsigned int mem_first_diff(const uint8_t *a, const uint8_t *b, unsigned int len);
+unsigned int mem_first_same(const uint8_t *a, const uint8_t *b, unsigned int len);
+unsigned int mem_count_diff(const uint8_t *a, const uint8_t *b, unsigned int len);
+
 /* flashrom.c */
 extern const char flashrom_version[];
 extern const char *chip_to_probe;
@@ -278,6 +344,7 @@ int read_flash_to_file(struct flashctx *flash, const char *filename);
 char *extract_param(const char *const *haystack, const char *needle, const char *delim);
 int verify_range(struct flashctx *flash, const uint8_t *cmpbuf, unsigned int start, unsigned int len);
 int need_erase(const uint8_t *have, const uint8_t *want, unsigned int len, enum write_granularity gran);
+const struct op_timing *erase_timing(const struct flashctx *flash, unsigned int len);
 void print_version(void);
 void print_buildinfo(void);
 void print_banner(void);
@@ -347,11 +414,20 @@ __attribute__((format(printf, 2, 3)));
 #define msg_cspew(...)	print(MSG_SPEW, __VA_ARGS__)	/* chip debug spew  */
 
 /* layout.c */
+#define MAX_ROMLAYOUT	32
+/* A contiguous part of the flash chip. */
+struct flash_range {
+	unsigned int start;
+	unsigned int len;
+};
 int register_include_arg(char *name);
 int process_include_args(void);
 int read_romlayout(const char *name);
 int normalize_romentries(const struct flashctx *flash);
 int build_new_image(struct flashctx *flash, bool oldcontents_valid, uint8_t *oldcontents, uint8_t *newcontents);
+bool layout_includes(unsigned int start, unsigned int len);
+void build_new_block(const uint8_t *oldblock, uint8_t *newblock, unsigned int start, unsigned int len);
+unsigned int layout_included_ranges(struct flash_range *ranges, unsigned int align, unsigned int size);
 void layout_cleanup(void);
 
 /* spi.c */
@@ -360,9 +436,20 @@ struct spi_command {
 	unsigned int readcnt;
 	const unsigned char *writearr;
 	unsigned char *readarr;
+	unsigned int delay_us; /* Wait this long after the command before sending the next one. */
 };
 int spi_send_command(struct flashctx *flash, unsigned int writecnt, unsigned int readcnt, const unsigned char *writearr, unsigned char *readarr);
 int spi_send_multicommand(struct flashctx *flash, struct spi_command *cmds);
+/* A batch of commands handed to the master with spi_submit(). The commands, and the buffers they point to,
+ * have to stay valid until done is set; result is then what spi_send_multicommand() would have returned. */
+struct spi_async {
+	struct spi_command *cmds;
+	int result;
+	bool done;
+};
+int spi_submit(struct flashctx *flash, struct spi_async *req);
+bool spi_poll(struct flashctx *flash, struct spi_async *req);
+int spi_wait(struct flashctx *flash, struct spi_async *req);
 uint32_t spi_get_valid_read_addr(struct flashctx *flash);
 
 enum chipbustype get_buses_supported(void);
@@ -2557,7 +2557,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256 /* or 264, determined from status register */,
 		/* does not support EWSR nor WREN and has no writable status register bits whatsoever */
 		/* OTP: 128B total, 64B pre-programmed; read 0x77; write 0x9B */
-		.feature_bits	= FEATURE_OTP,
+		.feature_bits	= FEATURE_OTP | FEATURE_AT45DB_BUFFER2,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_at45db,
 		.probe_timing	= TIMING_ZERO,
@@ -2599,7 +2599,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256 /* or 264, determined from status register */,
 		/* does not support EWSR nor WREN and has no writable status register bits whatsoever */
 		/* OTP: 128B total, 64B pre-programmed; read 0x77; write 0x9B */
-		.feature_bits	= FEATURE_OTP,
+		.feature_bits	= FEATURE_OTP | FEATURE_AT45DB_BUFFER2,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_at45db,
 		.probe_timing	= TIMING_ZERO,
@@ -2641,7 +2641,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256 /* or 264, determined from status register */,
 		/* does not support EWSR nor WREN and has no writable status register bits whatsoever */
 		/* OTP: 128B total, 64B pre-programmed; read 0x77; write 0x9B */
-		.feature_bits	= FEATURE_OTP,
+		.feature_bits	= FEATURE_OTP | FEATURE_AT45DB_BUFFER2,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_spi_at45db,
 		.probe_timing	= TIMING_ZERO,
@@ -2683,7 +2683,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 512 /* or 528, determined from status register */,
 		/* does not support EWSR nor WREN and has no writable status register bits whatsoever */
 		/* OTP: 128B total, 64B pre-programmed; read 0x77; write 0x9B */
-		.feature_bits	= FEATURE_OTP,
+		.feature_bits	= FEATURE_OTP | FEATURE_AT45DB_BUFFER2,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_at45db,
 		.probe_timing	= TIMING_ZERO,
@@ -2725,7 +2725,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 528 /* No power of two sizes */,
 		/* does not support EWSR nor WREN and has no writable status register bits whatsoever */
 		/* OTP: 128B total, 64B pre-programmed; read 0x77 (4 dummy bytes); write 0x9A (via buffer) */
-		.feature_bits	= FEATURE_OTP,
+		.feature_bits	= FEATURE_OTP | FEATURE_AT45DB_BUFFER2,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -2768,7 +2768,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 512 /* or 528, determined from status register */,
 		/* does not support EWSR nor WREN and has no writable status register bits whatsoever */
 		/* OTP: 128B total, 64B pre-programmed; read 0x77; write 0x9B */
-		.feature_bits	= FEATURE_OTP,
+		.feature_bits	= FEATURE_OTP | FEATURE_AT45DB_BUFFER2,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_at45db,
 		.probe_timing	= TIMING_ZERO,
@@ -2810,7 +2810,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 512 /* or 528, determined from status register */,
 		/* does not support EWSR nor WREN and has no writable status register bits whatsoever */
 		/* OTP: 128B total, 64B pre-programmed; read 0x77; write 0x9B */
-		.feature_bits	= FEATURE_OTP,
+		.feature_bits	= FEATURE_OTP | FEATURE_AT45DB_BUFFER2,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_spi_at45db,
 		.probe_timing	= TIMING_ZERO,
@@ -2852,7 +2852,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 1024 /* or 1056, determined from status register */,
 		/* does not support EWSR nor WREN and has no writable status register bits whatsoever */
 		/* OTP: 128B total, 64B pre-programmed; read 0x77; write 0x9B */
-		.feature_bits	= FEATURE_OTP,
+		.feature_bits	= FEATURE_OTP | FEATURE_AT45DB_BUFFER2,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_at45db,
 		.probe_timing	= TIMING_ZERO,
@@ -6106,7 +6106,9 @@ const struct flashchip flashchips[] = {
 		.total_size	= 4096,
 		.page_size	= 256,
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44 */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_FAST_READ | FEATURE_IO_1_1_2 |
+				  FEATURE_IO_1_2_2 | FEATURE_IO_1_1_4 | FEATURE_IO_1_4_4 | FEATURE_QE_SR2_BIT1 |
+				  FEATURE_PP_1_1_4,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -6134,6 +6136,16 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read, /* Fast read (0x0B) and multi I/O supported */
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {30, 50},
+			.page_program	= {600, 2400},
+			.sector_erase	= {50 * 1000, 200 * 1000},
+			.block32_erase	= {150 * 1000, 800 * 1000},
+			.block64_erase	= {250 * 1000, 1200 * 1000},
+			.chip_erase	= {10 * 1000 * 1000, 30 * 1000 * 1000},
+			.max_read_khz	= 80000,
+		},
 	},
 
 	{
@@ -6145,7 +6157,9 @@ const struct flashchip flashchips[] = {
 		.total_size	= 8192,
 		.page_size	= 256,
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44 */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_FAST_READ | FEATURE_IO_1_1_2 |
+				  FEATURE_IO_1_2_2 | FEATURE_IO_1_1_4 | FEATURE_IO_1_4_4 | FEATURE_QE_SR2_BIT1 |
+				  FEATURE_PP_1_1_4,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -6173,6 +6187,16 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read, /* Fast read (0x0B) and multi I/O supported */
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {30, 50},
+			.page_program	= {600, 2400},
+			.sector_erase	= {50 * 1000, 200 * 1000},
+			.block32_erase	= {150 * 1000, 800 * 1000},
+			.block64_erase	= {250 * 1000, 1200 * 1000},
+			.chip_erase	= {20 * 1000 * 1000, 60 * 1000 * 1000},
+			.max_read_khz	= 80000,
+		},
 	},
 
 	{
@@ -7897,7 +7921,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* MX25L6406E supports SFDP */
 		/* OTP: 06E 64B total; enter 0xB1, exit 0xC1 */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_FAST_READ | FEATURE_IO_1_1_2,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -7925,6 +7949,15 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read, /* Fast read (0x0B), dual I/O read supported */
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {9, 50},
+			.page_program	= {1400, 5000},
+			.sector_erase	= {60 * 1000, 300 * 1000},
+			.block64_erase	= {700 * 1000, 2000 * 1000},
+			.chip_erase	= {50 * 1000 * 1000, 80 * 1000 * 1000},
+			.max_read_khz	= 33000,
+		},
 	},
 
 	{
@@ -7937,7 +7970,9 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 512B total; enter 0xB1, exit 0xC1 */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_FAST_READ |
+				  FEATURE_IO_1_1_2 | FEATURE_IO_1_2_2 | FEATURE_IO_1_1_4 | FEATURE_IO_1_4_4 |
+				  FEATURE_QE_SR1_BIT6 | FEATURE_PP_1_4_4,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -7965,6 +8000,16 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read, /* Fast read (0x0B) and multi I/O supported */
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {9, 50},
+			.page_program	= {1400, 5000},
+			.sector_erase	= {60 * 1000, 300 * 1000},
+			.block32_erase	= {500 * 1000, 2000 * 1000},
+			.block64_erase	= {700 * 1000, 2000 * 1000},
+			.chip_erase	= {50 * 1000 * 1000, 80 * 1000 * 1000},
+			.max_read_khz	= 50000,
+		},
 	},
 
 	{
@@ -8043,6 +8088,58 @@ const struct flashchip flashchips[] = {
 		.voltage	= {2700, 3600},
 	},
 
+	{
+		.vendor		= "Macronix",
+		.name		= "MX25L25635F/MX25L25639F",
+		.bustype	= BUS_SPI,
+		.manufacture_id	= MACRONIX_ID,
+		.model_id	= MACRONIX_MX25L25635F,
+		.total_size	= 32768,
+		.page_size	= 256,
+		/* OTP: 512B total; enter 0xB1, exit 0xC1 */
+		/* 4-byte address mode: enter 0xB7, exit 0xE9; native 4-byte address opcodes supported */
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_FAST_READ |
+				  FEATURE_4BA_ENTER | FEATURE_4BA_NATIVE,
+		.tested		= TEST_UNTESTED,
+		.probe		= probe_spi_rdid,
+		.probe_timing	= TIMING_ZERO,
+		.block_erasers	=
+		{
+			{
+				.eraseblocks = { {4 * 1024, 8192} },
+				.block_erase = spi_block_erase_20,
+			}, {
+				.eraseblocks = { {32 * 1024, 1024} },
+				.block_erase = spi_block_erase_52,
+			}, {
+				.eraseblocks = { {64 * 1024, 512} },
+				.block_erase = spi_block_erase_d8,
+			}, {
+				.eraseblocks = { {32 * 1024 * 1024, 1} },
+				.block_erase = spi_block_erase_60,
+			}, {
+				.eraseblocks = { {32 * 1024 * 1024, 1} },
+				.block_erase = spi_block_erase_c7,
+			}
+		},
+		/* TODO: security register and SBLK/SBULK; configuration register */
+		.printlock	= spi_prettyprint_status_register_bp3_srwd, /* bit6 is quad enable */
+		.unlock		= spi_disable_blockprotect_bp3_srwd,
+		.write		= spi_chip_write_256,
+		.read		= spi_chip_read,
+		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {12, 30},
+			.page_program	= {500, 3000},
+			.sector_erase	= {43 * 1000, 200 * 1000},
+			.block32_erase	= {150 * 1000, 1000 * 1000},
+			.block64_erase	= {400 * 1000, 2000 * 1000},
+			.chip_erase	= {150 * 1000 * 1000, 300 * 1000 * 1000},
+			.max_read_khz	= 50000,
+		},
+	},
+
 	{
 		.vendor		= "Macronix",
 		.name		= "MX25U1635E",
@@ -11985,6 +12082,10 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read, /* Fast read (0x0B) supported */
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {14, 20},
+		},
 	},
 
 	{
@@ -12017,6 +12118,10 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read,
 		.voltage	= {3000, 3600},
+		.timing		=
+		{
+			.byte_program	= {14, 20},
+		},
 	},
 
 	{
@@ -12049,6 +12154,10 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read,
 		.voltage	= {3000, 3600},
+		.timing		=
+		{
+			.byte_program	= {14, 20},
+		},
 	},
 
 	{
@@ -12087,6 +12196,10 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read, /* Fast read (0x0B) supported by SST25VF512A only */
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {14, 20},
+		},
 	},
 
 	{
@@ -12125,6 +12238,10 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read, /* Fast read (0x0B) supported by SST25VF010A only */
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {14, 20},
+		},
 	},
 
 	{
@@ -12157,6 +12274,10 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read, /* only */
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {14, 20},
+		},
 	},
 
 	{
@@ -12227,6 +12348,10 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read,
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {14, 20},
+		},
 	},
 
 	{
@@ -14436,7 +14561,9 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_FAST_READ | FEATURE_IO_1_1_2 |
+				  FEATURE_IO_1_2_2 | FEATURE_IO_1_1_4 | FEATURE_IO_1_4_4 | FEATURE_QE_SR2_BIT1 |
+				  FEATURE_PP_1_1_4,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -14464,6 +14591,16 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read,
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {30, 50},
+			.page_program	= {700, 3000},
+			.sector_erase	= {45 * 1000, 400 * 1000},
+			.block32_erase	= {120 * 1000, 1600 * 1000},
+			.block64_erase	= {150 * 1000, 2000 * 1000},
+			.chip_erase	= {3 * 1000 * 1000, 10 * 1000 * 1000},
+			.max_read_khz	= 50000,
+		},
 	},
 
 	{
@@ -14476,7 +14613,9 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_FAST_READ | FEATURE_IO_1_1_2 |
+				  FEATURE_IO_1_2_2 | FEATURE_IO_1_1_4 | FEATURE_IO_1_4_4 | FEATURE_QE_SR2_BIT1 |
+				  FEATURE_PP_1_1_4,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -14504,6 +14643,16 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read,
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {30, 50},
+			.page_program	= {700, 3000},
+			.sector_erase	= {45 * 1000, 400 * 1000},
+			.block32_erase	= {120 * 1000, 1600 * 1000},
+			.block64_erase	= {150 * 1000, 2000 * 1000},
+			.chip_erase	= {10 * 1000 * 1000, 50 * 1000 * 1000},
+			.max_read_khz	= 50000,
+		},
 	},
 
 	{
@@ -14516,7 +14665,9 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_FAST_READ | FEATURE_IO_1_1_2 |
+				  FEATURE_IO_1_2_2 | FEATURE_IO_1_1_4 | FEATURE_IO_1_4_4 | FEATURE_QE_SR2_BIT1 |
+				  FEATURE_PP_1_1_4,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -14544,6 +14695,16 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read,
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {30, 50},
+			.page_program	= {700, 3000},
+			.sector_erase	= {45 * 1000, 400 * 1000},
+			.block32_erase	= {120 * 1000, 1600 * 1000},
+			.block64_erase	= {150 * 1000, 2000 * 1000},
+			.chip_erase	= {20 * 1000 * 1000, 100 * 1000 * 1000},
+			.max_read_khz	= 50000,
+		},
 	},
 
 	{
@@ -14556,7 +14717,9 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_FAST_READ | FEATURE_IO_1_1_2 |
+				  FEATURE_IO_1_2_2 | FEATURE_IO_1_1_4 | FEATURE_IO_1_4_4 | FEATURE_QE_SR2_BIT1 |
+				  FEATURE_PP_1_1_4,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -14584,6 +14747,69 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read,
 		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {30, 50},
+			.page_program	= {700, 3000},
+			.sector_erase	= {45 * 1000, 400 * 1000},
+			.block32_erase	= {120 * 1000, 1600 * 1000},
+			.block64_erase	= {150 * 1000, 2000 * 1000},
+			.chip_erase	= {40 * 1000 * 1000, 200 * 1000 * 1000},
+			.max_read_khz	= 50000,
+		},
+	},
+
+	{
+		.vendor		= "Winbond",
+		.name		= "W25Q256.V",
+		.bustype	= BUS_SPI,
+		.manufacture_id	= WINBOND_NEX_ID,
+		.model_id	= WINBOND_NEX_W25Q256_V,
+		.total_size	= 32768,
+		.page_size	= 256,
+		/* supports SFDP */
+		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
+		/* 4-byte address mode: enter 0xB7, exit 0xE9 */
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_FAST_READ | FEATURE_IO_1_1_2 |
+				  FEATURE_IO_1_2_2 | FEATURE_IO_1_1_4 | FEATURE_IO_1_4_4 | FEATURE_QE_SR2_BIT1 |
+				  FEATURE_PP_1_1_4 | FEATURE_4BA_ENTER,
+		.tested		= TEST_UNTESTED,
+		.probe		= probe_spi_rdid,
+		.probe_timing	= TIMING_ZERO,
+		.block_erasers	=
+		{
+			{
+				.eraseblocks = { {4 * 1024, 8192} },
+				.block_erase = spi_block_erase_20,
+			}, {
+				.eraseblocks = { {32 * 1024, 1024} },
+				.block_erase = spi_block_erase_52,
+			}, {
+				.eraseblocks = { {64 * 1024, 512} },
+				.block_erase = spi_block_erase_d8,
+			}, {
+				.eraseblocks = { {32 * 1024 * 1024, 1} },
+				.block_erase = spi_block_erase_60,
+			}, {
+				.eraseblocks = { {32 * 1024 * 1024, 1} },
+				.block_erase = spi_block_erase_c7,
+			}
+		},
+		.printlock	= spi_prettyprint_status_register_plain, /* TODO: improve */
+		.unlock		= spi_disable_blockprotect,
+		.write		= spi_chip_write_256,
+		.read		= spi_chip_read,
+		.voltage	= {2700, 3600},
+		.timing		=
+		{
+			.byte_program	= {30, 50},
+			.page_program	= {700, 3000},
+			.sector_erase	= {45 * 1000, 400 * 1000},
+			.block32_erase	= {120 * 1000, 1600 * 1000},
+			.block64_erase	= {150 * 1000, 2000 * 1000},
+			.chip_erase	= {80 * 1000 * 1000, 400 * 1000 * 1000},
+			.max_read_khz	= 50000,
+		},
 	},
 
 	{
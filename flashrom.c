@@ -38,6 +38,7 @@
 #endif
 #include "flash.h"
 #include "flashchips.h"
+#include "chipdrivers.h"
 #include "programmer.h"
 #include "hwaccess.h"
 
@@ -419,6 +420,18 @@ static int may_register_shutdown = 0;
 /* Did we change something or was every erase/write skipped (if any)? */
 static bool all_skipped = true;
 
+/* Ranges of the chip changed by erase_and_write_flash(), adjacent ones are merged. */
+static struct flash_range *modified_ranges = NULL;
+static unsigned int modified_count = 0;
+static unsigned int modified_max = 0;
+
+/* Ranges of the chip read and handled when writing only some regions, none means the whole chip. Erasers with
+ * blocks bigger than max_erase_block are not used then because they would cross the borders of these ranges.
+ */
+static struct flash_range read_ranges[MAX_ROMLAYOUT];
+static unsigned int read_range_count = 0;
+static unsigned int max_erase_block = 0;
+
 static int check_block_eraser(const struct flashctx *flash, int k, int log);
 
 int shutdown_free(void *data)
@@ -678,22 +691,15 @@ static unsigned int count_usable_erasers(const struct flashctx *flash)
 
 static int compare_range(const uint8_t *wantbuf, const uint8_t *havebuf, unsigned int start, unsigned int len)
 {
-	int ret = 0, failcount = 0;
-	unsigned int i;
-	for (i = 0; i < len; i++) {
-		if (wantbuf[i] != havebuf[i]) {
-			/* Only print the first failure. */
-			if (!failcount++)
-				msg_cerr("FAILED at 0x%08x! Expected=0x%02x, Found=0x%02x,",
-					 start + i, wantbuf[i], havebuf[i]);
-		}
-	}
-	if (failcount) {
-		msg_cerr(" failed byte count from 0x%08x-0x%08x: 0x%x\n",
-			 start, start + len - 1, failcount);
-		ret = -1;
-	}
-	return ret;
+	unsigned int i = mem_first_diff(wantbuf, havebuf, len);
+
+	if (i == len)
+		return 0;
+	/* Only print the first failure. */
+	msg_cerr("FAILED at 0x%08x! Expected=0x%02x, Found=0x%02x,", start + i, wantbuf[i], havebuf[i]);
+	msg_cerr(" failed byte count from 0x%08x-0x%08x: 0x%x\n",
+		 start, start + len - 1, mem_count_diff(wantbuf + i, havebuf + i, len - i));
+	return -1;
 }
 
 /* start is an offset to the base address of the flash chip */
@@ -762,16 +768,15 @@ out_free:
 /* Helper function for need_erase() that focuses on granularities of gran bytes. */
 static int need_erase_gran_bytes(const uint8_t *have, const uint8_t *want, unsigned int len, unsigned int gran)
 {
-	unsigned int i, j, limit;
+	unsigned int j, limit;
 	for (j = 0; j < len / gran; j++) {
 		limit = min (gran, len - j * gran);
 		/* Are 'have' and 'want' identical? */
 		if (!memcmp(have + j * gran, want + j * gran, limit))
 			continue;
 		/* have needs to be in erased state. */
-		for (i = 0; i < limit; i++)
-			if (have[j * gran + i] != 0xff)
-				return 1;
+		if (!mem_is_erased(have + j * gran, limit))
+			return 1;
 	}
 	return 0;
 }
@@ -793,22 +798,13 @@ static int need_erase_gran_bytes(const uint8_t *have, const uint8_t *want, unsig
 int need_erase(const uint8_t *have, const uint8_t *want, unsigned int len, enum write_granularity gran)
 {
 	int result = 0;
-	unsigned int i;
 
 	switch (gran) {
 	case write_gran_1bit:
-		for (i = 0; i < len; i++)
-			if ((have[i] & want[i]) != want[i]) {
-				result = 1;
-				break;
-			}
+		result = mem_need_erase_bits(have, want, len);
 		break;
 	case write_gran_1byte:
-		for (i = 0; i < len; i++)
-			if ((have[i] != want[i]) && (have[i] != 0xff)) {
-				result = 1;
-				break;
-			}
+		result = mem_need_erase_bytes(have, want, len);
 		break;
 	case write_gran_128bytes:
 		result = need_erase_gran_bytes(have, want, len, 128);
@@ -858,16 +854,18 @@ int need_erase(const uint8_t *have, const uint8_t *want, unsigned int len, enum
  * @first_start	offset of the first byte which needs to be written (passed in
  *		value is increased by the offset of the first needed write
  *		relative to have/want or unchanged if no write is needed)
+ * @chunk	size of the aligned windows (relative to the passed in value of
+ *		@first_start) written with one command, 0 to disable coalescing
  * @return	length of the first contiguous area which needs to be written
  *		0 if no write is needed
  *
- * FIXME: This function needs a parameter which tells it about coalescing
- * in relation to the max write length of the programmer and the max write
- * length of the chip.
+ * Areas that differ are merged with the following ones if the identical
+ * bytes between them lie within one chunk. Rewriting a few identical bytes
+ * is cheaper than sending another write command and waiting for it.
  */
 static unsigned int get_next_write(const uint8_t *have, const uint8_t *want, unsigned int len,
 			  unsigned int *first_start,
-			  enum write_granularity gran)
+			  enum write_granularity gran, unsigned int chunk)
 {
 	int need_write = 0;
 	unsigned int rel_start = 0, first_len = 0;
@@ -908,21 +906,42 @@ static unsigned int get_next_write(const uint8_t *have, const uint8_t *want, uns
 		 */
 		return 0;
 	}
-	for (i = 0; i < len / stride; i++) {
-		limit = min(stride, len - i * stride);
-		/* Are 'have' and 'want' identical? */
-		if (memcmp(have + i * stride, want + i * stride, limit)) {
-			if (!need_write) {
-				/* First location where have and want differ. */
-				need_write = 1;
-				rel_start = i * stride;
-			}
-		} else {
-			if (need_write) {
-				/* First location where have and want
-				 * do not differ anymore.
-				 */
+	/* Skip the identical chunks at the start. */
+	i = mem_first_diff(have, want, len / stride * stride) / stride;
+	if (stride == 1) {
+		/* The differing run ends at the first identical byte. */
+		if (i < len) {
+			need_write = 1;
+			rel_start = i;
+			i += mem_first_same(have + i, want + i, len - i);
+		}
+		/* A byte must not be rewritten on chips with write-once bytes. */
+		if (gran == write_gran_1byte)
+			chunk = 0;
+		while (need_write && chunk && i < len) {
+			unsigned int next = i + mem_first_diff(have + i, want + i, len - i);
+
+			if (next == len || (*first_start + i - 1) / chunk != (*first_start + next) / chunk)
 				break;
+			i = next + mem_first_same(have + next, want + next, len - next);
+		}
+	} else {
+		for (; i < len / stride; i++) {
+			limit = min(stride, len - i * stride);
+			/* Are 'have' and 'want' identical? */
+			if (memcmp(have + i * stride, want + i * stride, limit)) {
+				if (!need_write) {
+					/* First location where have and want differ. */
+					need_write = 1;
+					rel_start = i * stride;
+				}
+			} else {
+				if (need_write) {
+					/* First location where have and want
+					 * do not differ anymore.
+					 */
+					break;
+				}
 			}
 		}
 	}
@@ -1263,6 +1282,8 @@ notfound:
 	else
 #endif
 		msg_cinfo("on %s.\n", programmer_table[programmer].name);
+	if (flash->chip->timing.max_read_khz)
+		msg_cdbg("The datasheet allows reading at up to %u kHz.\n", flash->chip->timing.max_read_khz);
 
 	/* Flash registers may more likely not be mapped if the chip was forced.
 	 * Lock info may be stored in registers, so avoid lock info printing. */
@@ -1277,33 +1298,45 @@ notfound:
 	return chip - flashchips;
 }
 
-int read_buf_from_file(unsigned char *buf, unsigned long size,
-		       const char *filename)
+#ifndef __LIBPAYLOAD__
+/* Open the image file @filename for reading and check that it has the expected @size. */
+static FILE *open_image_file(const char *filename, unsigned long size)
 {
-#ifdef __LIBPAYLOAD__
-	msg_gerr("Error: No file I/O support in libpayload\n");
-	return 1;
-#else
-	int ret = 0;
-
 	FILE *image;
 	if ((image = fopen(filename, "rb")) == NULL) {
 		msg_gerr("Error: opening file \"%s\" failed: %s\n", filename, strerror(errno));
-		return 1;
+		return NULL;
 	}
 
 	struct stat image_stat;
 	if (fstat(fileno(image), &image_stat) != 0) {
 		msg_gerr("Error: getting metadata of file \"%s\" failed: %s\n", filename, strerror(errno));
-		ret = 1;
-		goto out;
+		goto fail;
 	}
 	if (image_stat.st_size != size) {
 		msg_gerr("Error: Image size (%jd B) doesn't match the flash chip's size (%lu B)!\n",
 			 (intmax_t)image_stat.st_size, size);
-		ret = 1;
-		goto out;
+		goto fail;
 	}
+	return image;
+fail:
+	(void)fclose(image);
+	return NULL;
+}
+#endif
+
+int read_buf_from_file(unsigned char *buf, unsigned long size,
+		       const char *filename)
+{
+#ifdef __LIBPAYLOAD__
+	msg_gerr("Error: No file I/O support in libpayload\n");
+	return 1;
+#else
+	int ret = 0;
+
+	FILE *image = open_image_file(filename, size);
+	if (!image)
+		return 1;
 
 	unsigned long numbytes = fread(buf, 1, size, image);
 	if (numbytes != size) {
@@ -1311,7 +1344,6 @@ int read_buf_from_file(unsigned char *buf, unsigned long size,
 			 "wanted %ld!\n", numbytes, size);
 		ret = 1;
 	}
-out:
 	(void)fclose(image);
 	return ret;
 #endif
@@ -1465,30 +1497,71 @@ static int selfcheck_eraseblocks(const struct flashchip *chip)
 	return ret;
 }
 
-static int erase_and_write_block_helper(struct flashctx *flash,
-					unsigned int start, unsigned int len,
-					uint8_t *curcontents,
-					uint8_t *newcontents,
-					int (*erasefn) (struct flashctx *flash,
-							unsigned int addr,
-							unsigned int len))
+static int note_modified_range(unsigned int start, unsigned int len)
+{
+	struct flash_range *last = modified_count ? &modified_ranges[modified_count - 1] : NULL;
+
+	if (last && last->start + last->len == start) {
+		last->len += len;
+		return 0;
+	}
+	if (modified_count == modified_max) {
+		unsigned int newmax = modified_max ? modified_max * 2 : 64;
+		struct flash_range *tmp = realloc(modified_ranges, newmax * sizeof(*tmp));
+
+		if (!tmp) {
+			msg_gerr("Out of memory!\n");
+			return 1;
+		}
+		modified_ranges = tmp;
+		modified_max = newmax;
+	}
+	modified_ranges[modified_count].start = start;
+	modified_ranges[modified_count].len = len;
+	modified_count++;
+	return 0;
+}
+
+/*
+ * Returns the number of bytes of an aligned window that is written with a single command, or 0 if writing is not
+ * done in such commands. Nearby writes inside one window are merged by get_next_write().
+ */
+static unsigned int write_chunk_size(const struct flashctx *flash)
+{
+	const struct flashchip *chip = flash->chip;
+	unsigned int chunk = chip->page_size;
+
+	/* Only SPI page programs have a significant cost per command. */
+	if (chip->bustype != BUS_SPI || chip->write != spi_chip_write_256)
+		return 0;
+	if (flash->mst->spi.max_data_write && flash->mst->spi.max_data_write < chunk)
+		chunk = flash->mst->spi.max_data_write;
+	return chunk > 1 ? chunk : 0;
+}
+
+/*
+ * Erase (if @do_erase is set) and write the block of @len bytes at @start. @curcontents and @newcontents hold the
+ * current and the wanted contents of just this block, @curcontents is updated along the way.
+ */
+static int erase_and_write_block(struct flashctx *flash, unsigned int start, unsigned int len,
+				 uint8_t *curcontents, const uint8_t *newcontents, erasefunc_t *erasefn, int do_erase)
 {
 	unsigned int starthere = 0, lenhere = 0;
 	int ret = 0, skip = 1, writecount = 0;
 	enum write_granularity gran = flash->chip->gran;
+	unsigned int chunk = write_chunk_size(flash);
 
-	/* curcontents and newcontents are opaque to walk_eraseregions, and
-	 * need to be adjusted here to keep the impression of proper abstraction
-	 */
-	curcontents += start;
-	newcontents += start;
 	msg_cdbg(":");
-	if (need_erase(curcontents, newcontents, len, gran)) {
+	if (do_erase) {
 		msg_cdbg("E");
 		ret = erasefn(flash, start, len);
 		if (ret)
 			return ret;
-		if (check_erased_range(flash, start, len)) {
+		/* When verifying blocks the written block is read back anyway, so a blank check is only needed if
+		 * the block stays erased.
+		 */
+		if ((!flash->flags.verify_blocks || mem_is_erased(newcontents, len)) &&
+		    check_erased_range(flash, start, len)) {
 			msg_cerr("ERASE FAILED!\n");
 			return -1;
 		}
@@ -1499,7 +1572,7 @@ static int erase_and_write_block_helper(struct flashctx *flash,
 	/* get_next_write() sets starthere to a new value after the call. */
 	while ((lenhere = get_next_write(curcontents + starthere,
 					 newcontents + starthere,
-					 len - starthere, &starthere, gran))) {
+					 len - starthere, &starthere, gran, chunk))) {
 		if (!writecount++)
 			msg_cdbg("W");
 		/* Needs the partial write function signature. */
@@ -1510,28 +1583,63 @@ static int erase_and_write_block_helper(struct flashctx *flash,
 		starthere += lenhere;
 		skip = 0;
 	}
-	if (skip)
+	if (skip) {
 		msg_cdbg("S");
-	else
-		all_skipped = false;
+		return ret;
+	}
+	all_skipped = false;
+	if (note_modified_range(start, len))
+		return -1;
+	if (flash->flags.verify_blocks) {
+		msg_cdbg("V");
+		if (verify_range(flash, newcontents, start, len)) {
+			msg_cerr("VERIFY FAILED!\n");
+			return -1;
+		}
+	}
 	return ret;
 }
 
-static int walk_eraseregions(struct flashctx *flash, int erasefunction,
+static int erase_and_write_block_helper(struct flashctx *flash,
+					unsigned int start, unsigned int len,
+					uint8_t *curcontents,
+					uint8_t *newcontents,
+					unsigned int base,
+					int (*erasefn) (struct flashctx *flash,
+							unsigned int addr,
+							unsigned int len))
+{
+	int do_erase = need_erase(curcontents + start - base, newcontents + start - base, len, flash->chip->gran);
+
+	/* curcontents and newcontents are opaque to walk_eraseregions, and
+	 * need to be adjusted here to keep the impression of proper abstraction
+	 */
+	return erase_and_write_block(flash, start, len, curcontents + start - base, newcontents + start - base,
+				     erasefn, do_erase);
+}
+
+/*
+ * Call @do_something for every block of erase function @erasefunction overlapping @area. @param1 and @param2
+ * hold the contents of the chip from address @base on. On success, @area is set to the blocks handled. If a
+ * block fails, @area is set to that block and 1 is returned.
+ */
+static int walk_eraseregions(struct flashctx *flash, int erasefunction, struct flash_range *area,
 			     int (*do_something) (struct flashctx *flash,
 						  unsigned int addr,
 						  unsigned int len,
 						  uint8_t *param1,
 						  uint8_t *param2,
+						  unsigned int base,
 						  int (*erasefn) (
 							struct flashctx *flash,
 							unsigned int addr,
 							unsigned int len)),
-			     void *param1, void *param2)
+			     void *param1, void *param2, unsigned int base)
 {
 	int i, j;
 	unsigned int start = 0;
 	unsigned int len;
+	unsigned int first = 0, last = 0, end = area->start + area->len;
 	struct block_eraser eraser = flash->chip->block_erasers[erasefunction];
 
 	for (i = 0; i < NUM_ERASEREGIONS; i++) {
@@ -1539,23 +1647,53 @@ static int walk_eraseregions(struct flashctx *flash, int erasefunction,
 		 * members so the loop below won't be executed for them.
 		 */
 		len = eraser.eraseblocks[i].size;
-		for (j = 0; j < eraser.eraseblocks[i].count; j++) {
+		for (j = 0; j < eraser.eraseblocks[i].count; j++, start += len) {
+			if (start + len <= area->start || start >= end)
+				continue;
 			/* Print this for every block except the first one. */
-			if (i || j)
+			if (last)
 				msg_cdbg(", ");
+			else
+				first = start;
 			msg_cdbg("0x%06x-0x%06x", start,
 				     start + len - 1);
-			if (do_something(flash, start, len, param1, param2,
+			if (do_something(flash, start, len, param1, param2, base,
 					 eraser.block_erase)) {
+				area->start = start;
+				area->len = len;
 				return 1;
 			}
-			start += len;
+			last = start + len;
 		}
 	}
 	msg_cdbg("\n");
+	if (last) {
+		area->start = first;
+		area->len = last - first;
+	}
 	return 0;
 }
 
+/* Returns the datasheet timing of erasing a block of @len bytes. All fields are 0 if it is unknown. */
+const struct op_timing *erase_timing(const struct flashctx *flash, unsigned int len)
+{
+	static const struct op_timing unknown = { 0 };
+	const struct chip_timing *timing = &flash->chip->timing;
+
+	if (len == flash->chip->total_size * 1024)
+		return &timing->chip_erase;
+	switch (len) {
+	case 4 * 1024:
+		return &timing->sector_erase;
+	case 32 * 1024:
+		return &timing->block32_erase;
+	case 64 * 1024:
+		return &timing->block64_erase;
+	default:
+		return &unknown;
+	}
+}
+
 static int check_block_eraser(const struct flashctx *flash, int k, int log)
 {
 	struct block_eraser eraser = flash->chip->block_erasers[k];
@@ -1577,148 +1715,907 @@ static int check_block_eraser(const struct flashctx *flash, int k, int log)
 				 "eraseblock layout is not defined. ");
 		return 1;
 	}
+	if (max_erase_block) {
+		int i;
+		for (i = 0; i < NUM_ERASEREGIONS; i++) {
+			if (eraser.eraseblocks[i].size > max_erase_block) {
+				if (log)
+					msg_cdbg("eraseblocks exceed the regions to be written. ");
+				return 1;
+			}
+		}
+	}
 	// TODO: Once erase functions are annotated with allowed buses, check that as well.
 	return 0;
 }
 
-int erase_and_write_flash(struct flashctx *flash, uint8_t *oldcontents, uint8_t *newcontents)
+/*
+ * If only some regions of the layout are to be written, restrict reading, erasing, writing and verifying to them.
+ * The regions are extended to the biggest erase block size (except for whole chip erasers) so that all erase
+ * decisions can be made from data actually read. Nothing outside of these ranges is touched afterwards.
+ */
+static void setup_read_ranges(struct flashctx *flash)
 {
-	int k, ret = 1;
-	uint8_t *curcontents;
-	unsigned long size = flash->chip->total_size * 1024;
-	unsigned int usable_erasefunctions = count_usable_erasers(flash);
-
-	msg_cinfo("Erasing and writing flash chip... ");
-	curcontents = malloc(size);
-	if (!curcontents) {
-		msg_gerr("Out of memory!\n");
-		exit(1);
-	}
-	/* Copy oldcontents to curcontents to avoid clobbering oldcontents. */
-	memcpy(curcontents, oldcontents, size);
+	const struct flashchip *chip = flash->chip;
+	unsigned int size = chip->total_size * 1024;
+	unsigned int align = 0, addr, i, j, r;
+	int k;
 
 	for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
-		if (k != 0)
-			msg_cinfo("Looking for another erase function.\n");
-		if (!usable_erasefunctions) {
-			msg_cinfo("No usable erase functions left.\n");
-			break;
-		}
-		msg_cdbg("Trying erase function %i... ", k);
-		if (check_block_eraser(flash, k, 1))
+		if (check_block_eraser(flash, k, 0))
 			continue;
-		usable_erasefunctions--;
-		ret = walk_eraseregions(flash, k, &erase_and_write_block_helper,
-					curcontents, newcontents);
-		/* If everything is OK, don't try another erase function. */
-		if (!ret)
-			break;
-		/* Write/erase failed, so try to find out what the current chip
-		 * contents are. If no usable erase functions remain, we can
-		 * skip this: the next iteration will break immediately anyway.
-		 */
-		if (!usable_erasefunctions)
+		for (i = 0; i < NUM_ERASEREGIONS; i++)
+			if (chip->block_erasers[k].eraseblocks[i].size < size)
+				align = max(align, chip->block_erasers[k].eraseblocks[i].size);
+	}
+	if (!align)
+		return;
+	read_range_count = layout_included_ranges(read_ranges, align, size);
+	if (!read_range_count)
+		return;
+	max_erase_block = align;
+
+	/* Make sure no erase block of a remaining eraser crosses the border of a range. */
+	for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+		const struct block_eraser *eraser = &chip->block_erasers[k];
+
+		if (check_block_eraser(flash, k, 0))
 			continue;
-		/* Reading the whole chip may take a while, inform the user even
-		 * in non-verbose mode.
-		 */
-		msg_cinfo("Reading current flash chip contents... ");
-		if (flash->chip->read(flash, curcontents, 0, size)) {
-			/* Now we are truly screwed. Read failed as well. */
-			msg_cerr("Can't read anymore! Aborting.\n");
-			/* We have no idea about the flash chip contents, so
-			 * retrying with another erase function is pointless.
-			 */
-			break;
+		addr = 0;
+		for (i = 0; i < NUM_ERASEREGIONS; i++) {
+			for (j = 0; j < eraser->eraseblocks[i].count; j++) {
+				unsigned int end = addr + eraser->eraseblocks[i].size;
+
+				for (r = 0; r < read_range_count; r++) {
+					unsigned int rstart = read_ranges[r].start;
+					unsigned int rend = rstart + read_ranges[r].len;
+
+					if (addr < rend && end > rstart && (addr < rstart || end > rend)) {
+						msg_cdbg("Erase blocks do not line up with the regions to be written, "
+							 "using the whole chip.\n");
+						read_range_count = 0;
+						max_erase_block = 0;
+						return;
+					}
+				}
+				addr = end;
+			}
 		}
-		msg_cinfo("done. ");
 	}
-	/* Free the scratchpad. */
-	free(curcontents);
+	msg_cdbg("Restricting the operation to %u range(s) aligned to %u kB.\n", read_range_count, align / 1024);
+}
 
-	if (ret) {
-		msg_cerr("FAILED!\n");
-	} else {
-		if (all_skipped)
-			msg_cinfo("\nWarning: Chip content is identical to the requested image.\n");
-		msg_cinfo("Erase/write done.\n");
+/* Read those parts of the chip into @buf that are handled by the current operation. */
+static int read_flash_ranges(struct flashctx *flash, uint8_t *buf)
+{
+	unsigned int i;
+
+	if (!read_range_count)
+		return flash->chip->read(flash, buf, 0, flash->chip->total_size * 1024);
+	for (i = 0; i < read_range_count; i++) {
+		if (flash->chip->read(flash, buf + read_ranges[i].start, read_ranges[i].start, read_ranges[i].len))
+			return 1;
 	}
+	return 0;
+}
+
+/* Compare those parts of the chip handled by the current operation to @cmpbuf. */
+static int verify_flash_ranges(struct flashctx *flash, const uint8_t *cmpbuf)
+{
+	unsigned int i;
+	int ret = 0;
+
+	if (!read_range_count)
+		return verify_range(flash, cmpbuf, 0, flash->chip->total_size * 1024);
+	for (i = 0; !ret && i < read_range_count; i++)
+		ret = verify_range(flash, cmpbuf + read_ranges[i].start, read_ranges[i].start, read_ranges[i].len);
 	return ret;
 }
 
-static void nonfatal_help_message(void)
+/*
+ * The erase planner looks at all usable block erasers of a chip at once and picks the cheapest way to get every
+ * part of the chip from @curcontents to @newcontents. Each part is either left alone and only written to (if that
+ * is possible without an erase) or erased with any eraser that has a block starting there. That way a few dirty
+ * sectors inside an otherwise unchanged region are handled with small erase blocks while a mostly dirty chip is
+ * erased with the largest blocks (or a chip erase).
+ *
+ * Costs are rough estimates of the time needed in microseconds. They are taken from the timing data of the chip
+ * where available. The defaults below are derived from typical SPI NOR datasheets and only need to be good enough
+ * to rank the alternatives.
+ */
+#define PLAN_ERASE_BASE_US	35000	/* Fixed cost of any erase operation. */
+#define PLAN_ERASE_KIB_US	2000	/* Erase time per kB of block size. */
+#define PLAN_READ_KIB_US	100	/* Reading back a kB to check the erase. */
+#define PLAN_WRITE_CHUNK_US	1000	/* Programming one page. */
+
+struct erase_plan_step {
+	unsigned int start;
+	unsigned int len;
+	int eraser;	/* Index into block_erasers or -1 if the block is only written to. */
+};
+
+struct erase_plan {
+	struct erase_plan_step *steps;
+	unsigned int count;
+	uint64_t cost;
+};
+
+/* Flattened list of blocks of one eraser. */
+struct plan_blocks {
+	unsigned int *start;
+	unsigned int *len;
+	unsigned int count;
+	unsigned int pos;
+};
+
+static uint64_t plan_erase_cost(const struct flashctx *flash, unsigned int len)
 {
-	msg_gerr("Good, writing to the flash chip apparently didn't do anything.\n");
-#if CONFIG_INTERNAL == 1
-	if (programmer == PROGRAMMER_INTERNAL)
-		msg_gerr("This means we have to add special support for your board, programmer or flash\n"
-			 "chip. Please report this on IRC at chat.freenode.net (channel #flashrom) or\n"
-			 "mail flashrom@flashrom.org, thanks!\n"
-			 "-------------------------------------------------------------------------------\n"
-			 "You may now reboot or simply leave the machine running.\n");
-	else
-#endif
-		msg_gerr("Please check the connections (especially those to write protection pins) between\n"
-			 "the programmer and the flash chip. If you think the error is caused by flashrom\n"
-			 "please report this on IRC at chat.freenode.net (channel #flashrom) or\n"
-			 "mail flashrom@flashrom.org, thanks!\n");
+	uint64_t read = (uint64_t)len * PLAN_READ_KIB_US / 1024;
+	uint32_t typ = erase_timing(flash, len)->typ;
+
+	if (typ)
+		return typ + read;
+	return PLAN_ERASE_BASE_US + (uint64_t)len * PLAN_ERASE_KIB_US / 1024 + read;
 }
 
-static void emergency_help_message(void)
+static uint64_t plan_write_cost(const struct flashctx *flash)
 {
-	msg_gerr("Your flash chip is in an unknown state.\n");
-#if CONFIG_INTERNAL == 1
-	if (programmer == PROGRAMMER_INTERNAL)
-		msg_gerr("Get help on IRC at chat.freenode.net (channel #flashrom) or\n"
-			"mail flashrom@flashrom.org with the subject \"FAILED: <your board name>\"!\n"
-			"-------------------------------------------------------------------------------\n"
-			"DO NOT REBOOT OR POWEROFF!\n");
-	else
-#endif
-		msg_gerr("Please report this on IRC at chat.freenode.net (channel #flashrom) or\n"
-			 "mail flashrom@flashrom.org, thanks!\n");
+	uint32_t typ = flash->chip->timing.page_program.typ;
+
+	return typ ? typ : PLAN_WRITE_CHUNK_US;
 }
 
-/* The way to go if you want a delimited list of programmers */
-void list_programmers(const char *delim)
+/* Size of the chunks used for estimating write costs. */
+static unsigned int plan_write_unit(const struct flashctx *flash)
 {
-	enum programmer p;
-	for (p = 0; p < PROGRAMMER_INVALID; p++) {
-		msg_ginfo("%s", programmer_table[p].name);
-		if (p < PROGRAMMER_INVALID - 1)
-			msg_ginfo("%s", delim);
-	}
-	msg_ginfo("\n");
+	unsigned int unit = flash->chip->page_size;
+
+	if (!unit || unit > 4096)
+		unit = 256;
+	return unit;
 }
 
-void list_programmers_linebreak(int startcol, int cols, int paren)
+/* Number of flagged write units in the range [start, start + len) according to the prefix sums in @sums. */
+static unsigned int plan_count_units(const uint32_t *sums, unsigned int unit, unsigned int start, unsigned int len)
 {
-	const char *pname;
-	int pnamelen;
-	int remaining = 0, firstline = 1;
-	enum programmer p;
-	int i;
+	return sums[(start + len - 1) / unit + 1] - sums[start / unit];
+}
 
-	for (p = 0; p < PROGRAMMER_INVALID; p++) {
-		pname = programmer_table[p].name;
-		pnamelen = strlen(pname);
-		if (remaining - pnamelen - 2 < 0) {
-			if (firstline)
-				firstline = 0;
-			else
-				msg_ginfo("\n");
-			for (i = 0; i < startcol; i++)
-				msg_ginfo(" ");
-			remaining = cols - startcol;
-		} else {
-			msg_ginfo(" ");
-			remaining--;
-		}
-		if (paren && (p == 0)) {
-			msg_ginfo("(");
-			remaining--;
-		}
-		msg_ginfo("%s", pname);
+static int plan_compare_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a;
+	unsigned int y = *(const unsigned int *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Returns the index of @addr in the sorted array @bounds (of length @count) or -1 if it is not there. */
+static int plan_find_bound(const unsigned int *bounds, unsigned int count, unsigned int addr)
+{
+	unsigned int lo = 0, hi = count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (bounds[mid] < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < count && bounds[lo] == addr)
+		return lo;
+	return -1;
+}
+
+/*
+ * Fill @plan with the cheapest sequence of blocks covering the whole chip. This is a shortest path search over
+ * all block boundaries of all usable erasers where each block (erased or only written) is an edge.
+ * Returns 0 on success, 1 if no plan could be made. Nothing is done to the chip itself.
+ */
+static int plan_erase_and_write(struct flashctx *flash, const uint8_t *curcontents, const uint8_t *newcontents,
+				struct erase_plan *plan)
+{
+	const struct flashchip *chip = flash->chip;
+	unsigned int size = chip->total_size * 1024;
+	unsigned int unit = plan_write_unit(flash);
+	unsigned int units = (size + unit - 1) / unit;
+	uint64_t wcost = plan_write_cost(flash);
+	struct plan_blocks blocks[NUM_ERASEFUNCTIONS] = {{0}};
+	unsigned int *bounds = NULL;
+	uint32_t *fill_sums = NULL, *diff_sums = NULL;
+	uint64_t *cost = NULL;
+	unsigned int *from = NULL;
+	signed char *how = NULL;
+	unsigned int nbounds = 0, nb, b, i, j, u;
+	int k, ret = 1;
+
+	memset(plan, 0, sizeof(*plan));
+
+	/* Flatten the eraseblock layouts of all usable erasers. */
+	for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+		const struct block_eraser *eraser = &chip->block_erasers[k];
+		unsigned int addr = 0, n = 0;
+
+		if (check_block_eraser(flash, k, 0))
+			continue;
+		for (i = 0; i < NUM_ERASEREGIONS; i++)
+			n += eraser->eraseblocks[i].count;
+		blocks[k].start = malloc(n * sizeof(*blocks[k].start));
+		blocks[k].len = malloc(n * sizeof(*blocks[k].len));
+		if (!blocks[k].start || !blocks[k].len) {
+			msg_gerr("Out of memory!\n");
+			goto out;
+		}
+		for (i = 0; i < NUM_ERASEREGIONS; i++) {
+			for (j = 0; j < eraser->eraseblocks[i].count; j++) {
+				blocks[k].start[blocks[k].count] = addr;
+				blocks[k].len[blocks[k].count] = eraser->eraseblocks[i].size;
+				blocks[k].count++;
+				addr += eraser->eraseblocks[i].size;
+			}
+		}
+		nbounds += n;
+	}
+	if (!nbounds)
+		goto out;
+
+	/* Collect all block boundaries in ascending order. The chip size serves as final boundary. */
+	bounds = malloc((nbounds + 1) * sizeof(*bounds));
+	if (!bounds) {
+		msg_gerr("Out of memory!\n");
+		goto out;
+	}
+	nbounds = 0;
+	for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+		memcpy(bounds + nbounds, blocks[k].start, blocks[k].count * sizeof(*bounds));
+		nbounds += blocks[k].count;
+	}
+	qsort(bounds, nbounds, sizeof(*bounds), plan_compare_uint);
+	for (i = 0, nb = 0; i < nbounds; i++) {
+		if (!nb || bounds[nb - 1] != bounds[i])
+			bounds[nb++] = bounds[i];
+	}
+	bounds[nb] = size;
+
+	/* Prefix sums of write units that need programming after an erase or without one, respectively. */
+	fill_sums = malloc((units + 1) * sizeof(*fill_sums));
+	diff_sums = malloc((units + 1) * sizeof(*diff_sums));
+	cost = malloc((nb + 1) * sizeof(*cost));
+	from = malloc((nb + 1) * sizeof(*from));
+	how = malloc((nb + 1) * sizeof(*how));
+	if (!fill_sums || !diff_sums || !cost || !from || !how) {
+		msg_gerr("Out of memory!\n");
+		goto out;
+	}
+	fill_sums[0] = diff_sums[0] = 0;
+	for (u = 0; u < units; u++) {
+		unsigned int len = min(unit, size - u * unit);
+		const uint8_t *want = newcontents + u * unit;
+
+		fill_sums[u + 1] = fill_sums[u] + !mem_is_erased(want, len);
+		diff_sums[u + 1] = diff_sums[u] + !!memcmp(curcontents + u * unit, want, len);
+	}
+
+	for (b = 0; b <= nb; b++)
+		cost[b] = UINT64_MAX;
+	cost[0] = 0;
+
+	for (b = 0; b < nb; b++) {
+		unsigned int addr = bounds[b];
+		unsigned int minlen = 0;
+		int e;
+
+		if (cost[b] == UINT64_MAX)
+			continue;
+		/* Find the blocks of each eraser starting here. */
+		for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+			struct plan_blocks *bl = &blocks[k];
+
+			while (bl->pos < bl->count && bl->start[bl->pos] < addr)
+				bl->pos++;
+			if (bl->pos == bl->count || bl->start[bl->pos] != addr)
+				continue;
+			if (!minlen || bl->len[bl->pos] < minlen)
+				minlen = bl->len[bl->pos];
+		}
+		if (!minlen)
+			continue;
+
+		/* Leave the smallest block alone if it can be written without an erase. */
+		if (!need_erase(curcontents + addr, newcontents + addr, minlen, chip->gran)) {
+			e = plan_find_bound(bounds, nb + 1, addr + minlen);
+			if (e > 0) {
+				uint64_t c = cost[b] + (uint64_t)plan_count_units(diff_sums, unit, addr, minlen) *
+					     wcost;
+				if (c < cost[e]) {
+					cost[e] = c;
+					from[e] = b;
+					how[e] = -1;
+				}
+			}
+		}
+
+		/* Erase a block with any of the erasers and write the new contents afterwards. */
+		for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+			struct plan_blocks *bl = &blocks[k];
+			unsigned int len;
+			uint64_t c;
+
+			if (bl->pos == bl->count || bl->start[bl->pos] != addr)
+				continue;
+			len = bl->len[bl->pos];
+			e = plan_find_bound(bounds, nb + 1, addr + len);
+			if (e <= 0)
+				continue;
+			c = cost[b] + plan_erase_cost(flash, len) +
+			    (uint64_t)plan_count_units(fill_sums, unit, addr, len) * wcost;
+			if (c < cost[e]) {
+				cost[e] = c;
+				from[e] = b;
+				how[e] = k;
+			}
+		}
+	}
+	if (cost[nb] == UINT64_MAX) {
+		msg_cdbg("No erase plan covers the whole chip. ");
+		goto out;
+	}
+
+	/* Walk the cheapest path backwards to find out how many steps there are, then record them. */
+	for (b = nb; b; b = from[b])
+		plan->count++;
+	plan->steps = malloc(plan->count * sizeof(*plan->steps));
+	if (!plan->steps) {
+		msg_gerr("Out of memory!\n");
+		plan->count = 0;
+		goto out;
+	}
+	for (b = nb, i = plan->count; b; b = from[b]) {
+		struct erase_plan_step *step = &plan->steps[--i];
+		step->start = bounds[from[b]];
+		step->len = bounds[b] - bounds[from[b]];
+		step->eraser = how[b];
+	}
+	plan->cost = cost[nb];
+	ret = 0;
+
+out:
+	for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+		free(blocks[k].start);
+		free(blocks[k].len);
+	}
+	free(bounds);
+	free(fill_sums);
+	free(diff_sums);
+	free(cost);
+	free(from);
+	free(how);
+	return ret;
+}
+
+/*
+ * Execute the steps of @plan from address @pos on. If a step fails, @area is set to its block, @failed to its
+ * erase function (negative if the block was only written to) and 1 is returned.
+ */
+static int execute_erase_plan(struct flashctx *flash, const struct erase_plan *plan, unsigned int pos,
+			      uint8_t *curcontents, uint8_t *newcontents, struct flash_range *area, int *failed)
+{
+	unsigned int i;
+	bool first = true;
+
+	for (i = 0; i < plan->count; i++) {
+		const struct erase_plan_step *step = &plan->steps[i];
+		erasefunc_t *erasefn = NULL;
+		int do_erase = step->eraser >= 0;
+
+		if (step->start + step->len <= pos)
+			continue;
+		if (step->eraser >= 0)
+			erasefn = flash->chip->block_erasers[step->eraser].block_erase;
+		/* The start of this block was redone by another erase function, check again. */
+		if (do_erase && step->start < pos)
+			do_erase = need_erase(curcontents + step->start, newcontents + step->start, step->len,
+					      flash->chip->gran);
+		/* Print this for every block except the first one. */
+		if (!first)
+			msg_cdbg(", ");
+		first = false;
+		msg_cdbg("0x%06x-0x%06x", step->start, step->start + step->len - 1);
+		if (erase_and_write_block(flash, step->start, step->len, curcontents + step->start,
+					  newcontents + step->start, erasefn, do_erase)) {
+			area->start = step->start;
+			area->len = step->len;
+			*failed = step->eraser;
+			return 1;
+		}
+	}
+	msg_cdbg("\n");
+	return 0;
+}
+
+/* Returns true if the blocks of erase function @k overlapping @area lie within [@base, @base + @size). */
+static bool blocks_within(const struct flashctx *flash, int k, const struct flash_range *area, unsigned int base,
+			  unsigned int size)
+{
+	const struct block_eraser *eraser = &flash->chip->block_erasers[k];
+	unsigned int pos = 0, len, i, j;
+
+	for (i = 0; i < NUM_ERASEREGIONS; i++) {
+		len = eraser->eraseblocks[i].size;
+		for (j = 0; j < eraser->eraseblocks[i].count; j++, pos += len) {
+			if (pos + len <= area->start || pos >= area->start + area->len)
+				continue;
+			if (pos < base || pos + len > base + size)
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * The block @area failed with erase function @failed (negative if it was only written to). Re-read just that
+ * block and redo it with the other erase functions. The buffers hold the contents of the chip from @base on
+ * for @size bytes, erase functions with blocks outside of them are not tried. On success, @resume is set to
+ * the end of the part of the chip handled, which may extend beyond the failed block if the other erase blocks
+ * are bigger.
+ */
+static int recover_block(struct flashctx *flash, int failed, struct flash_range *area, const uint8_t *oldcontents,
+			 uint8_t *curcontents, uint8_t *newcontents, unsigned int base, unsigned int size,
+			 unsigned int *resume)
+{
+	unsigned int end = area->start + area->len;
+	unsigned int tried = failed >= 0 ? 1 << failed : 0;
+	int k;
+
+	while (1) {
+		msg_cinfo("Reading current contents of 0x%06x-0x%06x... ", area->start,
+			  area->start + area->len - 1);
+		if (flash->chip->read(flash, curcontents + area->start - base, area->start, area->len)) {
+			/* We have no idea about the contents of the block, so retrying is pointless. */
+			msg_cerr("Can't read anymore! Aborting.\n");
+			return 1;
+		}
+		msg_cinfo("done. ");
+		if (memcmp(curcontents + area->start - base, oldcontents + area->start - base, area->len)) {
+			all_skipped = false;
+			if (note_modified_range(area->start, area->len))
+				return 1;
+		}
+		end = max(end, area->start + area->len);
+		area->len = end - area->start;
+
+		msg_cinfo("Looking for another erase function.\n");
+		for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+			if (tried & (1 << k))
+				continue;
+			msg_cdbg("Trying erase function %i... ", k);
+			if (!blocks_within(flash, k, area, base, size))
+				msg_cdbg("its blocks are not loaded, skipping.\n");
+			else if (!check_block_eraser(flash, k, 1))
+				break;
+			tried |= 1 << k;
+		}
+		if (k == NUM_ERASEFUNCTIONS) {
+			msg_cinfo("No usable erase functions left.\n");
+			return 1;
+		}
+		tried |= 1 << k;
+		if (!walk_eraseregions(flash, k, area, &erase_and_write_block_helper, curcontents, newcontents,
+				       base)) {
+			*resume = max(end, area->start + area->len);
+			return 0;
+		}
+	}
+}
+
+static void print_erase_plan(const struct erase_plan *plan)
+{
+	unsigned int uses[NUM_ERASEFUNCTIONS] = {0};
+	unsigned int i, skipped = 0;
+	int k;
+
+	for (i = 0; i < plan->count; i++) {
+		if (plan->steps[i].eraser < 0)
+			skipped++;
+		else
+			uses[plan->steps[i].eraser]++;
+	}
+	msg_cdbg("Using erase plan with %u blocks (estimated %llu ms). ", plan->count,
+		 (unsigned long long)(plan->cost / 1000));
+	msg_cdbg2("\n%u blocks need no erase", skipped);
+	for (k = 0; k < NUM_ERASEFUNCTIONS; k++)
+		if (uses[k])
+			msg_cdbg2(", %u blocks use erase function %i", uses[k], k);
+	msg_cdbg2(".\n");
+}
+
+int erase_and_write_flash(struct flashctx *flash, uint8_t *oldcontents, uint8_t *newcontents)
+{
+	int k = 0, failed, ret = 1;
+	uint8_t *curcontents;
+	unsigned long size = flash->chip->total_size * 1024;
+	unsigned int pos = 0;
+	struct flash_range area;
+	struct erase_plan plan;
+	bool planned = false;
+
+	msg_cinfo("Erasing and writing flash chip... ");
+	modified_count = 0;
+	curcontents = malloc(size);
+	if (!curcontents) {
+		msg_gerr("Out of memory!\n");
+		exit(1);
+	}
+	/* Copy oldcontents to curcontents to avoid clobbering oldcontents. */
+	memcpy(curcontents, oldcontents, size);
+
+	if (!plan_erase_and_write(flash, curcontents, newcontents, &plan)) {
+		print_erase_plan(&plan);
+		planned = true;
+	} else {
+		for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+			msg_cdbg("Trying erase function %i... ", k);
+			if (!check_block_eraser(flash, k, 1))
+				break;
+		}
+	}
+
+	/* If a block fails, only that block is re-read and redone with another erase function before the
+	 * remaining blocks are handled as before.
+	 */
+	while (planned || k < NUM_ERASEFUNCTIONS) {
+		if (planned) {
+			ret = execute_erase_plan(flash, &plan, pos, curcontents, newcontents, &area, &failed);
+		} else {
+			area.start = pos;
+			area.len = size - pos;
+			failed = k;
+			ret = walk_eraseregions(flash, k, &area, &erase_and_write_block_helper,
+						curcontents, newcontents, 0);
+		}
+		if (!ret)
+			break;
+		ret = recover_block(flash, failed, &area, oldcontents, curcontents, newcontents, 0, size, &pos);
+		if (ret || pos >= size)
+			break;
+	}
+	if (planned)
+		free(plan.steps);
+	else if (k == NUM_ERASEFUNCTIONS)
+		msg_cinfo("No usable erase functions left.\n");
+	/* Free the scratchpad. */
+	free(curcontents);
+
+	if (ret) {
+		msg_cerr("FAILED!\n");
+	} else {
+		if (all_skipped)
+			msg_cinfo("\nWarning: Chip content is identical to the requested image.\n");
+		msg_cinfo("Erase/write done.\n");
+	}
+	return ret;
+}
+
+/*
+ * Make sure the chip has finished all internal operations before reading it back. Chips driven by the generic
+ * SPI code report this in their status register, all others get a fixed delay.
+ */
+static int wait_until_ready(struct flashctx *flash)
+{
+	const struct flashchip *chip = flash->chip;
+
+	if (chip->bustype == BUS_SPI &&
+	    (chip->write == spi_chip_write_256 || chip->write == spi_chip_write_1 || chip->write == spi_aai_write))
+		return spi_wait_ready(flash, SPI_WAIT_IDLE, 0, 1000 * 1000);
+	programmer_delay(1000 * 1000);
+	return 0;
+}
+
+#ifndef __LIBPAYLOAD__
+/*
+ * Returns the erase function with the smallest blocks to keep the memory usage of streaming low and sets @maxlen
+ * to the size of its biggest block, or returns -1 if there is no usable erase function.
+ */
+static int stream_eraser(const struct flashctx *flash, unsigned int *maxlen)
+{
+	int k, best = -1;
+	unsigned int i;
+
+	for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+		unsigned int blockmax = 0;
+
+		if (check_block_eraser(flash, k, 0))
+			continue;
+		for (i = 0; i < NUM_ERASEREGIONS; i++)
+			blockmax = max(blockmax, flash->chip->block_erasers[k].eraseblocks[i].size);
+		if (best < 0 || blockmax < *maxlen) {
+			best = k;
+			*maxlen = blockmax;
+		}
+	}
+	return best;
+}
+
+/*
+ * The streamed block @area failed with erase function @failed. Redo it with recover_block() on buffers holding
+ * the part of the chip covered by whole blocks of every usable erase function except those erasing the whole
+ * chip: the current contents from the chip, the new ones from @image. @oldblock holds the contents of @area
+ * before it was touched. On success, @resume is set to the end of the part of the chip handled.
+ */
+static int stream_recover_block(struct flashctx *flash, FILE *image, int failed, struct flash_range *area,
+				const uint8_t *oldblock, unsigned int *resume)
+{
+	const struct flashchip *chip = flash->chip;
+	unsigned int start = area->start, end = area->start + area->len, prevstart, prevend, pos, len, i, j;
+	uint8_t *oldcontents = NULL, *curcontents = NULL, *newcontents = NULL;
+	int k, ret = 1;
+
+	do {
+		prevstart = start;
+		prevend = end;
+		for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+			if (check_block_eraser(flash, k, 0) ||
+			    chip->block_erasers[k].eraseblocks[0].size >= chip->total_size * 1024)
+				continue;
+			for (i = 0, pos = 0; i < NUM_ERASEREGIONS; i++) {
+				len = chip->block_erasers[k].eraseblocks[i].size;
+				for (j = 0; j < chip->block_erasers[k].eraseblocks[i].count; j++, pos += len) {
+					if (pos + len <= start || pos >= end)
+						continue;
+					start = min(start, pos);
+					end = max(end, pos + len);
+				}
+			}
+		}
+	} while (start != prevstart || end != prevend);
+
+	len = end - start;
+	oldcontents = malloc(len);
+	curcontents = malloc(len);
+	newcontents = malloc(len);
+	if (!oldcontents || !curcontents || !newcontents) {
+		msg_gerr("Out of memory!\n");
+		goto out;
+	}
+	if (chip->read(flash, curcontents, start, len)) {
+		msg_cerr("Reading the chip at 0x%06x failed.\n", start);
+		goto out;
+	}
+	/* Only @area has been touched since it was read. */
+	memcpy(oldcontents, curcontents, len);
+	memcpy(oldcontents + area->start - start, oldblock, area->len);
+	if (fseek(image, start, SEEK_SET) || fread(newcontents, 1, len, image) != len) {
+		msg_gerr("Error: Failed to read the image at 0x%06x.\n", start);
+		goto out;
+	}
+	build_new_block(oldcontents, newcontents, start, len);
+	ret = recover_block(flash, failed, area, oldcontents, curcontents, newcontents, start, len, resume);
+out:
+	free(oldcontents);
+	free(curcontents);
+	free(newcontents);
+	return ret;
+}
+#endif
+
+/*
+ * Write the image in @filename one erase block at a time. Only the current and the new contents of a single block
+ * are held in memory and the image file is read as needed, so the first block is written right away instead of
+ * after reading the whole chip. Blocks excluded by the layout are neither read nor written.
+ */
+static int stream_write_flash(struct flashctx *flash, const char *filename)
+{
+#ifdef __LIBPAYLOAD__
+	msg_gerr("Error: No file I/O support in libpayload\n");
+	return 1;
+#else
+	const struct flashchip *chip = flash->chip;
+	const struct block_eraser *eraser;
+	unsigned int maxlen = 0, start = 0, resume = 0, len, i, j;
+	uint8_t *oldblock = NULL, *curblock = NULL, *newblock = NULL;
+	int best, ret = 1;
+	FILE *image;
+
+	best = stream_eraser(flash, &maxlen);
+	if (best < 0) {
+		msg_cerr("No usable erase functions left.\n");
+		return 1;
+	}
+	eraser = &chip->block_erasers[best];
+
+	image = open_image_file(filename, chip->total_size * 1024);
+	if (!image)
+		return 1;
+	oldblock = malloc(maxlen);
+	curblock = malloc(maxlen);
+	newblock = malloc(maxlen);
+	if (!oldblock || !curblock || !newblock) {
+		msg_gerr("Out of memory!\n");
+		goto out;
+	}
+
+	msg_cinfo("Erasing and writing flash chip... ");
+	msg_cdbg("Streaming with erase function %i.\n", best);
+	modified_count = 0;
+	for (i = 0; i < NUM_ERASEREGIONS; i++) {
+		len = eraser->eraseblocks[i].size;
+		for (j = 0; j < eraser->eraseblocks[i].count; j++, start += len) {
+			/* Already redone with another erase function. */
+			if (start + len <= resume)
+				continue;
+			/* Print this for every block except the first one. */
+			if (start)
+				msg_cdbg(", ");
+			msg_cdbg("0x%06x-0x%06x", start, start + len - 1);
+			if (!layout_includes(start, len)) {
+				msg_cdbg(":S");
+				continue;
+			}
+			if (fseek(image, start, SEEK_SET) || fread(newblock, 1, len, image) != len) {
+				msg_gerr("Error: Failed to read the image at 0x%06x.\n", start);
+				goto out;
+			}
+			if (chip->read(flash, curblock, start, len)) {
+				msg_cerr("Reading the chip at 0x%06x failed.\n", start);
+				goto out;
+			}
+			build_new_block(curblock, newblock, start, len);
+			/* erase_and_write_block() updates curblock. */
+			memcpy(oldblock, curblock, len);
+			if (erase_and_write_block(flash, start, len, curblock, newblock, eraser->block_erase,
+						  need_erase(curblock, newblock, len, chip->gran))) {
+				struct flash_range area = { .start = start, .len = len };
+
+				if (stream_recover_block(flash, image, best, &area, oldblock, &resume))
+					goto out;
+			}
+		}
+	}
+	msg_cdbg("\n");
+	ret = 0;
+out:
+	free(oldblock);
+	free(curblock);
+	free(newblock);
+	(void)fclose(image);
+	if (ret) {
+		msg_cerr("FAILED!\n");
+	} else {
+		if (all_skipped)
+			msg_cinfo("\nWarning: Chip content is identical to the requested image.\n");
+		msg_cinfo("Erase/write done.\n");
+	}
+	return ret;
+#endif
+}
+
+/*
+ * Read back the ranges modified by stream_write_flash() and compare them to the image in @filename in pieces of
+ * the size of the streamed erase blocks. Everything else is known to be unchanged.
+ */
+static int stream_verify_flash(struct flashctx *flash, const char *filename)
+{
+#ifdef __LIBPAYLOAD__
+	msg_gerr("Error: No file I/O support in libpayload\n");
+	return 1;
+#else
+	unsigned int maxlen = 0, pos, end, len, i;
+	uint8_t *curblock = NULL, *newblock = NULL;
+	int ret = 1;
+	FILE *image;
+
+	if (stream_eraser(flash, &maxlen) < 0)
+		return 1;
+	image = open_image_file(filename, flash->chip->total_size * 1024);
+	if (!image)
+		return 1;
+	curblock = malloc(maxlen);
+	newblock = malloc(maxlen);
+	if (!curblock || !newblock) {
+		msg_gerr("Out of memory!\n");
+		goto out;
+	}
+	if (wait_until_ready(flash))
+		goto out;
+	for (i = 0; i < modified_count; i++) {
+		end = modified_ranges[i].start + modified_ranges[i].len;
+		for (pos = modified_ranges[i].start; pos < end; pos += len) {
+			len = min(maxlen, end - pos);
+			if (fseek(image, pos, SEEK_SET) || fread(newblock, 1, len, image) != len) {
+				msg_gerr("Error: Failed to read the image at 0x%06x.\n", pos);
+				goto out;
+			}
+			if (flash->chip->read(flash, curblock, pos, len)) {
+				msg_gerr("Verification impossible because read failed at 0x%x (len 0x%x)\n", pos, len);
+				goto out;
+			}
+			/* Bytes outside the layout were written back unchanged, they are not in the image. */
+			build_new_block(curblock, newblock, pos, len);
+			if (compare_range(newblock, curblock, pos, len))
+				goto out;
+		}
+	}
+	ret = 0;
+out:
+	free(curblock);
+	free(newblock);
+	(void)fclose(image);
+	return ret;
+#endif
+}
+
+static void nonfatal_help_message(void)
+{
+	msg_gerr("Good, writing to the flash chip apparently didn't do anything.\n");
+#if CONFIG_INTERNAL == 1
+	if (programmer == PROGRAMMER_INTERNAL)
+		msg_gerr("This means we have to add special support for your board, programmer or flash\n"
+			 "chip. Please report this on IRC at chat.freenode.net (channel #flashrom) or\n"
+			 "mail flashrom@flashrom.org, thanks!\n"
+			 "-------------------------------------------------------------------------------\n"
+			 "You may now reboot or simply leave the machine running.\n");
+	else
+#endif
+		msg_gerr("Please check the connections (especially those to write protection pins) between\n"
+			 "the programmer and the flash chip. If you think the error is caused by flashrom\n"
+			 "please report this on IRC at chat.freenode.net (channel #flashrom) or\n"
+			 "mail flashrom@flashrom.org, thanks!\n");
+}
+
+static void emergency_help_message(void)
+{
+	msg_gerr("Your flash chip is in an unknown state.\n");
+#if CONFIG_INTERNAL == 1
+	if (programmer == PROGRAMMER_INTERNAL)
+		msg_gerr("Get help on IRC at chat.freenode.net (channel #flashrom) or\n"
+			"mail flashrom@flashrom.org with the subject \"FAILED: <your board name>\"!\n"
+			"-------------------------------------------------------------------------------\n"
+			"DO NOT REBOOT OR POWEROFF!\n");
+	else
+#endif
+		msg_gerr("Please report this on IRC at chat.freenode.net (channel #flashrom) or\n"
+			 "mail flashrom@flashrom.org, thanks!\n");
+}
+
+/* The way to go if you want a delimited list of programmers */
+void list_programmers(const char *delim)
+{
+	enum programmer p;
+	for (p = 0; p < PROGRAMMER_INVALID; p++) {
+		msg_ginfo("%s", programmer_table[p].name);
+		if (p < PROGRAMMER_INVALID - 1)
+			msg_ginfo("%s", delim);
+	}
+	msg_ginfo("\n");
+}
+
+void list_programmers_linebreak(int startcol, int cols, int paren)
+{
+	const char *pname;
+	int pnamelen;
+	int remaining = 0, firstline = 1;
+	enum programmer p;
+	int i;
+
+	for (p = 0; p < PROGRAMMER_INVALID; p++) {
+		pname = programmer_table[p].name;
+		pnamelen = strlen(pname);
+		if (remaining - pnamelen - 2 < 0) {
+			if (firstline)
+				firstline = 0;
+			else
+				msg_ginfo("\n");
+			for (i = 0; i < startcol; i++)
+				msg_ginfo(" ");
+			remaining = cols - startcol;
+		} else {
+			msg_ginfo(" ");
+			remaining--;
+		}
+		if (paren && (p == 0)) {
+			msg_ginfo("(");
+			remaining--;
+		}
+		msg_ginfo("%s", pname);
 		remaining -= pnamelen;
 		if (p < PROGRAMMER_INVALID - 1) {
 			msg_ginfo(",");
@@ -1978,37 +2875,45 @@ int chip_safety_check(const struct flashctx *flash, int force, int read_it, int
 	return 0;
 }
 
-/* This function signature is horrible. We need to design a better interface,
- * but right now it allows us to split off the CLI code.
- * Besides that, the function itself is a textbook example of abysmal code flow.
- */
-int doit(struct flashctx *flash, int force, const char *filename, int read_it,
-	 int write_it, int erase_it, int verify_it)
+/* The actual work of doit() once the chip is accessible. */
+static int doit_accessible(struct flashctx *flash, const char *filename, int read_it,
+			   int write_it, int erase_it, int verify_it)
 {
-	uint8_t *oldcontents;
-	uint8_t *newcontents;
+	uint8_t *oldcontents = NULL;
+	uint8_t *newcontents = NULL;
 	int ret = 0;
 	unsigned long size = flash->chip->total_size * 1024;
-	int read_all_first = 1; /* FIXME: Make this configurable. */
+	unsigned int i;
 
-	if (chip_safety_check(flash, force, read_it, write_it, erase_it, verify_it)) {
-		msg_cerr("Aborting.\n");
-		return 1;
+	if (read_it) {
+		return read_flash_to_file(flash, filename);
 	}
 
-	if (normalize_romentries(flash)) {
-		msg_cerr("Requested regions can not be handled. Aborting.\n");
-		return 1;
+#if CONFIG_INTERNAL == 1
+	/* The board check needs the complete image. */
+	if (write_it && flash->flags.stream && programmer == PROGRAMMER_INTERNAL) {
+		msg_cinfo("Streaming is not supported by the internal programmer.\n");
+		flash->flags.stream = false;
 	}
-
-	/* Given the existence of read locks, we want to unlock for read,
-	 * erase and write.
-	 */
-	if (flash->chip->unlock)
-		flash->chip->unlock(flash);
-
-	if (read_it) {
-		return read_flash_to_file(flash, filename);
+#endif
+	if (write_it && flash->flags.stream) {
+		if (stream_write_flash(flash, filename)) {
+			if (all_skipped)
+				nonfatal_help_message();
+			else
+				emergency_help_message();
+			ret = 1;
+			goto out;
+		}
+		if (verify_it && !all_skipped) {
+			msg_cinfo("Verifying flash... ");
+			ret = stream_verify_flash(flash, filename);
+			if (ret)
+				emergency_help_message();
+			else
+				msg_cinfo("VERIFIED.\n");
+		}
+		goto out;
 	}
 
 	oldcontents = malloc(size);
@@ -2065,24 +2970,23 @@ int doit(struct flashctx *flash, int force, const char *filename, int read_it,
 #endif
 	}
 
-	/* Read the whole chip to be able to check whether regions need to be
-	 * erased and to give better diagnostics in case write fails.
-	 * The alternative is to read only the regions which are to be
-	 * preserved, but in that case we might perform unneeded erase which
-	 * takes time as well.
+	/* Read the chip to be able to check whether regions need to be erased
+	 * and to give better diagnostics in case write fails. If only some
+	 * regions are to be handled, read just those (extended to whole erase
+	 * blocks). The rest stays zero in both oldcontents and newcontents and
+	 * is thus never touched.
 	 */
-	if (read_all_first) {
-		msg_cinfo("Reading old flash chip contents... ");
-		if (flash->chip->read(flash, oldcontents, 0, size)) {
-			ret = 1;
-			msg_cinfo("FAILED.\n");
-			goto out;
-		}
+	setup_read_ranges(flash);
+	msg_cinfo("Reading old flash chip contents... ");
+	if (read_flash_ranges(flash, oldcontents)) {
+		ret = 1;
+		msg_cinfo("FAILED.\n");
+		goto out;
 	}
 	msg_cinfo("done.\n");
 
 	/* Build a new image taking the given layout into account. */
-	if (build_new_image(flash, read_all_first, oldcontents, newcontents)) {
+	if (build_new_image(flash, true, oldcontents, newcontents)) {
 		msg_gerr("Could not prepare the data to be written, aborting.\n");
 		ret = 1;
 		goto out;
@@ -2091,25 +2995,19 @@ int doit(struct flashctx *flash, int force, const char *filename, int read_it,
 	// ////////////////////////////////////////////////////////////
 
 	if (write_it && erase_and_write_flash(flash, oldcontents, newcontents)) {
-		msg_cerr("Uh oh. Erase/write failed. ");
-		if (read_all_first) {
-			msg_cerr("Checking if anything has changed.\n");
-			msg_cinfo("Reading current flash chip contents... ");
-			if (!flash->chip->read(flash, newcontents, 0, size)) {
-				msg_cinfo("done.\n");
-				if (!memcmp(oldcontents, newcontents, size)) {
-					nonfatal_help_message();
-					ret = 1;
-					goto out;
-				}
-				msg_cerr("Apparently at least some data has changed.\n");
-			} else
-				msg_cerr("Can't even read anymore!\n");
-			emergency_help_message();
-			ret = 1;
-			goto out;
+		msg_cerr("Uh oh. Erase/write failed. Checking if anything has changed.\n");
+		msg_cinfo("Reading current flash chip contents... ");
+		/* Outside of the ranges read, newcontents equals oldcontents already. */
+		if (!read_flash_ranges(flash, newcontents)) {
+			msg_cinfo("done.\n");
+			if (!memcmp(oldcontents, newcontents, size)) {
+				nonfatal_help_message();
+				ret = 1;
+				goto out;
+			}
+			msg_cerr("Apparently at least some data has changed.\n");
 		} else
-			msg_cerr("\n");
+			msg_cerr("Can't even read anymore!\n");
 		emergency_help_message();
 		ret = 1;
 		goto out;
@@ -2119,10 +3017,18 @@ int doit(struct flashctx *flash, int force, const char *filename, int read_it,
 	if (verify_it && (!write_it || !all_skipped)) {
 		msg_cinfo("Verifying flash... ");
 
-		if (write_it) {
+		if (write_it && flash->flags.verify_blocks) {
+			/* Everything else is known to be unchanged. */
+			ret = wait_until_ready(flash);
+			for (i = 0; !ret && i < modified_count; i++)
+				ret = verify_range(flash, newcontents + modified_ranges[i].start,
+						   modified_ranges[i].start, modified_ranges[i].len);
+			if (ret)
+				emergency_help_message();
+		} else if (write_it) {
 			/* Work around chips which need some time to calm down. */
 			programmer_delay(1000*1000);
-			ret = verify_range(flash, newcontents, 0, size);
+			ret = verify_flash_ranges(flash, newcontents);
 			/* If we tried to write, and verification now fails, we
 			 * might have an emergency situation.
 			 */
@@ -2138,5 +3044,51 @@ int doit(struct flashctx *flash, int force, const char *filename, int read_it,
 out:
 	free(oldcontents);
 	free(newcontents);
+	free(modified_ranges);
+	modified_ranges = NULL;
+	modified_count = modified_max = 0;
+	read_range_count = 0;
+	max_erase_block = 0;
+	return ret;
+}
+
+/* This function signature is horrible. We need to design a better interface,
+ * but right now it allows us to split off the CLI code.
+ * Besides that, the function itself is a textbook example of abysmal code flow.
+ */
+int doit(struct flashctx *flash, int force, const char *filename, int read_it,
+	 int write_it, int erase_it, int verify_it)
+{
+	int ret;
+
+	if (chip_safety_check(flash, force, read_it, write_it, erase_it, verify_it)) {
+		msg_cerr("Aborting.\n");
+		return 1;
+	}
+
+	if (normalize_romentries(flash)) {
+		msg_cerr("Requested regions can not be handled. Aborting.\n");
+		return 1;
+	}
+
+	/* Given the existence of read locks, we want to unlock for read,
+	 * erase and write.
+	 */
+	if (flash->chip->unlock)
+		flash->chip->unlock(flash);
+
+	/* Chips bigger than 16 MiB may have to be switched to 4-byte addresses. */
+	if ((flash->chip->bustype & BUS_SPI) && spi_enter_4ba(flash)) {
+		msg_cerr("Aborting.\n");
+		return 1;
+	}
+
+	ret = doit_accessible(flash, filename, read_it, write_it, erase_it, verify_it);
+
+	/* Leave the chip in the mode the next user (e.g. firmware) expects. */
+	if ((flash->chip->bustype & BUS_SPI) && spi_restore_quad_io(flash))
+		ret = 1;
+	if (spi_exit_4ba(flash))
+		ret = 1;
 	return ret;
 }
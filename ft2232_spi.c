@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include "flash.h"
+#include "chipdrivers.h"
 #include "programmer.h"
 #include "spi.h"
 #include <ftdi.h>
@@ -102,6 +103,8 @@ const struct dev_entry devs_ft2232spi[] = {
 static uint8_t cs_bits = 0x08;
 static uint8_t pindir = 0x0b;
 static struct ftdi_context ftdic_context;
+/* SPI clock of high-speed chips in kHz, 0 on chips that can't clock the bus without transferring data. */
+static unsigned int idle_clock_khz = 0;
 
 static const char *get_ft2232_devicename(int ft2232_vid, int ft2232_type)
 {
@@ -135,13 +138,13 @@ static int send_buf(struct ftdi_context *ftdic, const unsigned char *buf,
 	return 0;
 }
 
-static int get_buf(struct ftdi_context *ftdic, const unsigned char *buf,
+static int get_buf(struct ftdi_context *ftdic, unsigned char *buf,
 		   int size)
 {
 	int r;
 
 	while (size > 0) {
-		r = ftdi_read_data(ftdic, (unsigned char *) buf, size);
+		r = ftdi_read_data(ftdic, buf, size);
 		if (r < 0) {
 			msg_perr("ftdi_read_data: %d, %s\n", r, ftdi_get_error_string(ftdic));
 			return 1;
@@ -157,13 +160,26 @@ static int ft2232_spi_send_command(struct flashctx *flash,
 				   const unsigned char *writearr,
 				   unsigned char *readarr);
 
+static int ft2232_spi_send_multicommand(struct flashctx *flash, struct spi_command *cmds);
+static int ft2232_spi_multicommand_poll(struct flashctx *flash, struct spi_command *cmds, unsigned int delay_us,
+					unsigned int step_us, unsigned int count, uint8_t *status);
+#if HAVE_FTDI_ASYNC
+static int ft2232_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len);
+#endif
+
 static const struct spi_master spi_master_ft2232 = {
 	.type		= SPI_CONTROLLER_FT2232,
 	.max_data_read	= 64 * 1024,
 	.max_data_write	= 256,
+	.features	= SPI_MASTER_4BA,
 	.command	= ft2232_spi_send_command,
-	.multicommand	= default_spi_send_multicommand,
+	.multicommand	= ft2232_spi_send_multicommand,
+	.multicommand_poll = ft2232_spi_multicommand_poll,
+#if HAVE_FTDI_ASYNC
+	.read		= ft2232_spi_read,
+#else
 	.read		= default_spi_read,
+#endif
 	.write_256	= default_spi_write_256,
 	.write_aai	= default_spi_write_aai,
 };
@@ -400,6 +416,8 @@ int ft2232_spi_init(void)
 
 	msg_pdbg("MPSSE clock: %f MHz, divisor: %u, SPI clock: %f MHz\n",
 		 mpsse_clk, divisor, (double)(mpsse_clk / divisor));
+	if (clock_5x)
+		idle_clock_khz = mpsse_clk * 1000 / divisor;
 
 	/* Disconnect TDI/DO to TDO/DI for loopback. */
 	msg_pdbg("No loopback of TDI/DO TDO/DI\n");
@@ -517,4 +535,234 @@ static int ft2232_spi_send_command(struct flashctx *flash,
 	return failed ? -1 : 0;
 }
 
+/* Longest delay done by clocking the bus, longer ones are left to the host. */
+#define FT2232_MAX_IDLE_US	(100 * 1000)
+
+/* Length of the commands appended by ft2232_clock_idle(). */
+static unsigned int ft2232_clock_idle_len(unsigned int us)
+{
+	return 3 * ((us * idle_clock_khz / 1000 + 8 * 65536 - 1) / (8 * 65536));
+}
+
+/* Append commands clocking the bus for at least us microseconds with CS# deasserted. Returns the length. */
+static int ft2232_clock_idle(unsigned char *buf, unsigned int us)
+{
+	unsigned int bytes = (us * idle_clock_khz / 1000 + 7) / 8;
+	unsigned int chunk;
+	int i = 0;
+
+	for (; bytes; bytes -= chunk) {
+		chunk = min(bytes, 65536);
+		buf[i++] = 0x8f; /* Clock n bytes without data transfer. CLK_BYTES in newer libftdi */
+		buf[i++] = (chunk - 1) & 0xff;
+		buf[i++] = ((chunk - 1) >> 8) & 0xff;
+	}
+	return i;
+}
+
+/*
+ * Responses a packed transfer may produce. The whole buffer is written before anything is read back, so the
+ * responses have to fit into the receive FIFO of the chip (384 bytes on the FT2232D) or the MPSSE stalls.
+ */
+#define FT2232_MAX_PACKED_READ	384
+
+/*
+ * Send all commands, the delays and the RDSR polls in one USB transfer and collect all responses with a single
+ * read. The delays are done by the MPSSE engine which clocks the bus with CS# deasserted.
+ * Returns SPI_INVALID_OPCODE without sending anything if the sequence can not be packed.
+ */
+static int ft2232_spi_send_packed(struct spi_command *cmds, unsigned int delay_us, unsigned int step_us,
+				  unsigned int count, uint8_t *status)
+{
+	struct ftdi_context *ftdic = &ftdic_context;
+	struct spi_command *cmd;
+	unsigned char *buf, *readbuf;
+	unsigned int k, bufsize = 0, readsize = count, readpos = 0;
+	bool idle = count;
+	int i = 0, ret;
+
+	if (delay_us > FT2232_MAX_IDLE_US || step_us > FT2232_MAX_IDLE_US)
+		return SPI_INVALID_OPCODE;
+	for (cmd = cmds; cmd->writecnt || cmd->readcnt; cmd++) {
+		if (cmd->writecnt > 65536 || cmd->readcnt > 65536)
+			return SPI_INVALID_LENGTH;
+		if (cmd->delay_us > FT2232_MAX_IDLE_US)
+			return SPI_INVALID_OPCODE;
+		idle |= cmd->delay_us;
+		bufsize += 3 + 3 + cmd->writecnt + 3 + 3 + ft2232_clock_idle_len(cmd->delay_us);
+		readsize += cmd->readcnt;
+	}
+	/* Only the FT2232H and FT232H can clock the bus without transferring data. */
+	if ((idle && !idle_clock_khz) || readsize > FT2232_MAX_PACKED_READ)
+		return SPI_INVALID_OPCODE;
+	/* CS# framing, RDSR and the read of its result per poll. */
+	bufsize += count * (3 + 4 + 3 + 3);
+	bufsize += count * ft2232_clock_idle_len(max(delay_us, step_us));
+
+	buf = malloc(bufsize);
+	readbuf = malloc(readsize + 1);
+	if (!buf || !readbuf) {
+		msg_perr("Out of memory!\n");
+		free(buf);
+		free(readbuf);
+		return SPI_GENERIC_ERROR;
+	}
+
+	for (cmd = cmds; cmd->writecnt || cmd->readcnt; cmd++) {
+		buf[i++] = SET_BITS_LOW;
+		buf[i++] = 0 & ~cs_bits; /* assertive */
+		buf[i++] = pindir;
+		if (cmd->writecnt) {
+			buf[i++] = MPSSE_DO_WRITE | MPSSE_WRITE_NEG;
+			buf[i++] = (cmd->writecnt - 1) & 0xff;
+			buf[i++] = ((cmd->writecnt - 1) >> 8) & 0xff;
+			memcpy(buf + i, cmd->writearr, cmd->writecnt);
+			i += cmd->writecnt;
+		}
+		if (cmd->readcnt) {
+			buf[i++] = MPSSE_DO_READ;
+			buf[i++] = (cmd->readcnt - 1) & 0xff;
+			buf[i++] = ((cmd->readcnt - 1) >> 8) & 0xff;
+		}
+		buf[i++] = SET_BITS_LOW;
+		buf[i++] = cs_bits;
+		buf[i++] = pindir;
+		i += ft2232_clock_idle(buf + i, cmd->delay_us);
+	}
+	for (k = 0; k < count; k++) {
+		i += ft2232_clock_idle(buf + i, k ? step_us : delay_us);
+		buf[i++] = SET_BITS_LOW;
+		buf[i++] = 0 & ~cs_bits; /* assertive */
+		buf[i++] = pindir;
+		buf[i++] = MPSSE_DO_WRITE | MPSSE_WRITE_NEG;
+		buf[i++] = 0;
+		buf[i++] = 0;
+		buf[i++] = JEDEC_RDSR;
+		buf[i++] = MPSSE_DO_READ;
+		buf[i++] = 0;
+		buf[i++] = 0;
+		buf[i++] = SET_BITS_LOW;
+		buf[i++] = cs_bits;
+		buf[i++] = pindir;
+	}
+
+	ret = send_buf(ftdic, buf, i);
+	if (ret)
+		msg_perr("send_buf failed: %i\n", ret);
+	else
+		ret = get_buf(ftdic, readbuf, readsize);
+	if (!ret) {
+		for (cmd = cmds; cmd->writecnt || cmd->readcnt; cmd++) {
+			if (cmd->readcnt)
+				memcpy(cmd->readarr, readbuf + readpos, cmd->readcnt);
+			readpos += cmd->readcnt;
+		}
+		if (count)
+			memcpy(status, readbuf + readpos, count);
+	}
+	free(buf);
+	free(readbuf);
+	return ret ? -1 : 0;
+}
+
+/* WREN, the program command and the like go out in one USB transfer, with their responses read in one go. */
+static int ft2232_spi_send_multicommand(struct flashctx *flash, struct spi_command *cmds)
+{
+	const int ret = ft2232_spi_send_packed(cmds, 0, 0, 0, NULL);
+
+	if (ret == SPI_INVALID_OPCODE)
+		return default_spi_send_multicommand(flash, cmds);
+	return ret;
+}
+
+static int ft2232_spi_multicommand_poll(struct flashctx *flash, struct spi_command *cmds, unsigned int delay_us,
+					unsigned int step_us, unsigned int count, uint8_t *status)
+{
+	return ft2232_spi_send_packed(cmds, delay_us, step_us, count, status);
+}
+
+#if HAVE_FTDI_ASYNC
+/* Length of each MPSSE read command and of the USB transfer collecting its data. */
+#define FT2232_READ_CHUNK	65536
+/* MPSSE read commands ft2232_spi_read() keeps queued in the FTDI ahead of the data collected so far. */
+#define FT2232_READ_AHEAD	2
+
+/*
+ * Read len bytes with a single read command. The data is clocked out by back-to-back MPSSE reads which are queued
+ * while the USB transfer for an earlier one is still in flight, so the bus never waits for the host to ask for
+ * more. libftdi keeps the state of asynchronous reads in its context, hence only one of them may be pending.
+ */
+static int ft2232_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len)
+{
+	struct ftdi_context *ftdic = &ftdic_context;
+	struct ftdi_transfer_control *tc = NULL;
+	unsigned char cmd[1 + JEDEC_MAX_ADDR_LEN + 1];
+	unsigned char mpsse[3 + 3 + sizeof(cmd) + 3 + 3];
+	unsigned int queued = 0, done = 0, pending = 0, chunk;
+	int writecnt, r, i = 0, failed = 0;
+
+	writecnt = spi_prepare_read(flash, cmd, start);
+	if (writecnt < 0)
+		return 1;
+
+	msg_pspew("Assert CS#\n");
+	mpsse[i++] = SET_BITS_LOW;
+	mpsse[i++] = 0 & ~cs_bits; /* assertive */
+	mpsse[i++] = pindir;
+	mpsse[i++] = MPSSE_DO_WRITE | MPSSE_WRITE_NEG;
+	mpsse[i++] = (writecnt - 1) & 0xff;
+	mpsse[i++] = ((writecnt - 1) >> 8) & 0xff;
+	memcpy(mpsse + i, cmd, writecnt);
+	i += writecnt;
+
+	while (1) {
+		for (; !failed && queued < len && queued - done < FT2232_READ_AHEAD * FT2232_READ_CHUNK;
+		     queued += chunk) {
+			chunk = min(len - queued, FT2232_READ_CHUNK);
+			mpsse[i++] = MPSSE_DO_READ;
+			mpsse[i++] = (chunk - 1) & 0xff;
+			mpsse[i++] = ((chunk - 1) >> 8) & 0xff;
+			if (queued + chunk == len) {
+				msg_pspew("De-assert CS#\n");
+				mpsse[i++] = SET_BITS_LOW;
+				mpsse[i++] = cs_bits;
+				mpsse[i++] = pindir;
+			}
+			failed = send_buf(ftdic, mpsse, i);
+			i = 0;
+			if (failed)
+				break;
+		}
+		/* The read command of a pending transfer has been sent already, so it always finishes. */
+		if (tc) {
+			r = ftdi_transfer_data_done(tc);
+			tc = NULL;
+			if (r != pending && !failed) {
+				msg_perr("ftdi_transfer_data_done: %d, %s\n", r, ftdi_get_error_string(ftdic));
+				failed = 1;
+			}
+			done += pending;
+		}
+		if (failed || done == len)
+			break;
+		pending = min(len - done, FT2232_READ_CHUNK);
+		tc = ftdi_read_data_submit(ftdic, buf + done, pending);
+		if (!tc) {
+			msg_perr("ftdi_read_data_submit failed: %s\n", ftdi_get_error_string(ftdic));
+			failed = 1;
+			break;
+		}
+	}
+
+	if (failed && queued < len) {
+		/* The read command was cut short, CS# is still asserted. */
+		mpsse[0] = SET_BITS_LOW;
+		mpsse[1] = cs_bits;
+		mpsse[2] = pindir;
+		send_buf(ftdic, mpsse, 3);
+	}
+	return failed;
+}
+#endif
+
 #endif
@@ -1427,6 +1427,8 @@ static int ich_spi_send_multicommand(struct flashctx *flash,
 		}
 		ret = ich_spi_send_command(flash, cmds->writecnt, cmds->readcnt,
 					   cmds->writearr, cmds->readarr);
+		if (!ret && cmds->delay_us)
+			programmer_delay(cmds->delay_us);
 		/* Reset the type of all opcodes to non-atomic. */
 		for (i = 0; i < 8; i++)
 			curopcodes->opcode[i].atomic = 0;
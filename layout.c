@@ -26,8 +26,6 @@
 #include "flash.h"
 #include "programmer.h"
 
-#define MAX_ROMLAYOUT	32
-
 typedef struct {
 	chipoff_t start;
 	chipoff_t end;
@@ -313,3 +311,79 @@ int build_new_image(struct flashctx *flash, bool oldcontents_valid, uint8_t *old
 	}
 	return 0;
 }
+
+/* Returns true if any part of the range [start, start + len) is to be written according to the layout. */
+bool layout_includes(unsigned int start, unsigned int len)
+{
+	romentry_t *entry;
+
+	if (num_include_args == 0)
+		return true;
+	entry = get_next_included_romentry(start);
+	return entry && entry->start < start + len;
+}
+
+/**
+ * Store the parts of the chip included by the layout in @ranges, each extended to a multiple of @align and
+ * clamped to @size. Overlapping and adjacent parts are merged, so at most MAX_ROMLAYOUT ranges are stored.
+ * Returns the number of ranges or 0 if no regions were included (i.e. the whole chip is to be written).
+ */
+unsigned int layout_included_ranges(struct flash_range *ranges, unsigned int align, unsigned int size)
+{
+	unsigned int pos = 0, count = 0, start, end;
+	romentry_t *entry;
+
+	if (num_include_args == 0)
+		return 0;
+
+	while (pos < size) {
+		entry = get_next_included_romentry(pos);
+		if (!entry || entry->start >= size)
+			break;
+		start = max(entry->start, pos) / align * align;
+		end = min(entry->end, size - 1) / align * align + align;
+		if (end > size)
+			end = size;
+		if (count && start <= ranges[count - 1].start + ranges[count - 1].len)
+			ranges[count - 1].len = end - ranges[count - 1].start;
+		else {
+			ranges[count].start = start;
+			ranges[count].len = end - start;
+			count++;
+		}
+		pos = entry->end + 1;
+		/* Catch overflow. */
+		if (!pos)
+			break;
+	}
+	return count;
+}
+
+/**
+ * Like build_new_image(), but only for the range [start, start + len) of the chip. @oldblock and @newblock hold
+ * the current and the new contents of that range. @oldblock must be valid wherever the layout excludes parts of
+ * the range.
+ */
+void build_new_block(const uint8_t *oldblock, uint8_t *newblock, unsigned int start, unsigned int len)
+{
+	unsigned int pos = start, end = start + len;
+	romentry_t *entry;
+
+	if (num_include_args == 0)
+		return;
+
+	while (pos < end) {
+		entry = get_next_included_romentry(pos);
+		if (!entry || entry->start >= end) {
+			memcpy(newblock + pos - start, oldblock + pos - start, end - pos);
+			break;
+		}
+		/* For non-included region, copy from old content. */
+		if (entry->start > pos)
+			memcpy(newblock + pos - start, oldblock + pos - start, entry->start - pos);
+		/* The rest of the range is included. */
+		if (entry->end >= end - 1)
+			break;
+		pos = entry->end + 1;
+	}
+}
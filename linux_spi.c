@@ -68,6 +68,7 @@ int linux_spi_init(void)
 {
 	char *p, *endp, *dev;
 	uint32_t speed_hz = 0;
+	struct spi_master mst = spi_master_linux;
 	/* FIXME: make the following configurable by CLI options. */
 	/* SPI mode 0 (beware this also includes: MSB first, CS active low and others */
 	const uint8_t mode = SPI_MODE_0;
@@ -127,7 +128,11 @@ int linux_spi_init(void)
 		return 1;
 	}
 
-	register_spi_master(&spi_master_linux);
+	/* The driver's default is used if no speed was given. */
+	if (ioctl(fd, SPI_IOC_RD_MAX_SPEED_HZ, &speed_hz) == 0)
+		mst.clock_khz = speed_hz / 1000;
+
+	register_spi_master(&mst);
 
 	return 0;
 }
@@ -182,6 +187,18 @@ static int linux_spi_send_command(struct flashctx *flash, unsigned int writecnt,
 static int linux_spi_read(struct flashctx *flash, uint8_t *buf,
 			  unsigned int start, unsigned int len)
 {
+	const unsigned int max_khz = spi_max_read_khz(flash);
+	uint32_t speed_hz = max_khz * 1000;
+
+	if (max_khz && flash->mst->spi.clock_khz > max_khz) {
+		if (ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) == -1) {
+			msg_perr("%s: failed to lower speed to %d Hz: %s\n",
+				 __func__, speed_hz, strerror(errno));
+			return 1;
+		}
+		msg_pdbg("Lowered the clock to %u kHz for reading this chip\n", max_khz);
+		flash->mst->spi.clock_khz = max_khz;
+	}
 	return spi_read_chunked(flash, buf, start, len,
 				(unsigned int)getpagesize());
 }
@@ -0,0 +1,335 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Scanning of image buffers. Comparing old and new contents of a whole chip is done several times per write
+ * operation, so these loops are vectorized on x86 where the CPU supports it. The implementation is selected at
+ * runtime on first use.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "flash.h"
+#include "platform.h"
+
+#if IS_X86 && !(defined(__DJGPP__) || defined(__LIBPAYLOAD__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define MEMOPS_X86 1
+#include <immintrin.h>
+#else
+#define MEMOPS_X86 0
+#endif
+
+struct memops {
+	const char *name;
+	int (*is_erased)(const uint8_t *buf, unsigned int len);
+	int (*need_bits)(const uint8_t *have, const uint8_t *want, unsigned int len);
+	int (*need_bytes)(const uint8_t *have, const uint8_t *want, unsigned int len);
+	unsigned int (*find)(const uint8_t *a, const uint8_t *b, unsigned int len, int equal);
+	unsigned int (*count_diff)(const uint8_t *a, const uint8_t *b, unsigned int len);
+};
+
+static int scalar_is_erased(const uint8_t *buf, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		if (buf[i] != 0xff)
+			return 0;
+	return 1;
+}
+
+static int scalar_need_bits(const uint8_t *have, const uint8_t *want, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		if ((have[i] & want[i]) != want[i])
+			return 1;
+	return 0;
+}
+
+static int scalar_need_bytes(const uint8_t *have, const uint8_t *want, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		if ((have[i] != want[i]) && (have[i] != 0xff))
+			return 1;
+	return 0;
+}
+
+static unsigned int scalar_find(const uint8_t *a, const uint8_t *b, unsigned int len, int equal)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		if ((a[i] == b[i]) == equal)
+			break;
+	return i;
+}
+
+static unsigned int scalar_count_diff(const uint8_t *a, const uint8_t *b, unsigned int len)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i < len; i++)
+		count += (a[i] != b[i]);
+	return count;
+}
+
+static const struct memops scalar_ops = {
+	.name		= "scalar",
+	.is_erased	= scalar_is_erased,
+	.need_bits	= scalar_need_bits,
+	.need_bytes	= scalar_need_bytes,
+	.find		= scalar_find,
+	.count_diff	= scalar_count_diff,
+};
+
+#if MEMOPS_X86
+/* All vector loops handle full vectors only and leave the remainder to the scalar functions. */
+
+__attribute__((target("sse2")))
+static int sse2_is_erased(const uint8_t *buf, unsigned int len)
+{
+	const __m128i ff = _mm_set1_epi8(-1);
+	unsigned int i;
+
+	for (i = 0; i + 64 <= len; i += 64) {
+		__m128i acc = _mm_loadu_si128((const __m128i *)(buf + i));
+		acc = _mm_and_si128(acc, _mm_loadu_si128((const __m128i *)(buf + i + 16)));
+		acc = _mm_and_si128(acc, _mm_loadu_si128((const __m128i *)(buf + i + 32)));
+		acc = _mm_and_si128(acc, _mm_loadu_si128((const __m128i *)(buf + i + 48)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, ff)) != 0xffff)
+			return 0;
+	}
+	return scalar_is_erased(buf + i, len - i);
+}
+
+__attribute__((target("sse2")))
+static int sse2_need_bits(const uint8_t *have, const uint8_t *want, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i h = _mm_loadu_si128((const __m128i *)(have + i));
+		__m128i w = _mm_loadu_si128((const __m128i *)(want + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(h, w), w)) != 0xffff)
+			return 1;
+	}
+	return scalar_need_bits(have + i, want + i, len - i);
+}
+
+__attribute__((target("sse2")))
+static int sse2_need_bytes(const uint8_t *have, const uint8_t *want, unsigned int len)
+{
+	const __m128i ff = _mm_set1_epi8(-1);
+	unsigned int i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i h = _mm_loadu_si128((const __m128i *)(have + i));
+		__m128i w = _mm_loadu_si128((const __m128i *)(want + i));
+		__m128i ok = _mm_or_si128(_mm_cmpeq_epi8(h, w), _mm_cmpeq_epi8(h, ff));
+		if (_mm_movemask_epi8(ok) != 0xffff)
+			return 1;
+	}
+	return scalar_need_bytes(have + i, want + i, len - i);
+}
+
+__attribute__((target("sse2")))
+static unsigned int sse2_find(const uint8_t *a, const uint8_t *b, unsigned int len, int equal)
+{
+	/* Bits of the comparison mask that are set for bytes we are not looking for. */
+	const unsigned int skip = equal ? 0 : 0xffff;
+	unsigned int i, mask;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) ^ skip;
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+	return i + scalar_find(a + i, b + i, len - i, equal);
+}
+
+__attribute__((target("sse2,popcnt")))
+static unsigned int sse2_count_diff(const uint8_t *a, const uint8_t *b, unsigned int len)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		count += 16 - __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)));
+	}
+	return count + scalar_count_diff(a + i, b + i, len - i);
+}
+
+static const struct memops sse2_ops = {
+	.name		= "SSE2",
+	.is_erased	= sse2_is_erased,
+	.need_bits	= sse2_need_bits,
+	.need_bytes	= sse2_need_bytes,
+	.find		= sse2_find,
+	.count_diff	= sse2_count_diff,
+};
+
+__attribute__((target("avx2")))
+static int avx2_is_erased(const uint8_t *buf, unsigned int len)
+{
+	const __m256i ff = _mm256_set1_epi8(-1);
+	unsigned int i;
+
+	for (i = 0; i + 128 <= len; i += 128) {
+		__m256i acc = _mm256_loadu_si256((const __m256i *)(buf + i));
+		acc = _mm256_and_si256(acc, _mm256_loadu_si256((const __m256i *)(buf + i + 32)));
+		acc = _mm256_and_si256(acc, _mm256_loadu_si256((const __m256i *)(buf + i + 64)));
+		acc = _mm256_and_si256(acc, _mm256_loadu_si256((const __m256i *)(buf + i + 96)));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(acc, ff)) != -1)
+			return 0;
+	}
+	return sse2_is_erased(buf + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static int avx2_need_bits(const uint8_t *have, const uint8_t *want, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		__m256i h = _mm256_loadu_si256((const __m256i *)(have + i));
+		__m256i w = _mm256_loadu_si256((const __m256i *)(want + i));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(h, w), w)) != -1)
+			return 1;
+	}
+	return scalar_need_bits(have + i, want + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static int avx2_need_bytes(const uint8_t *have, const uint8_t *want, unsigned int len)
+{
+	const __m256i ff = _mm256_set1_epi8(-1);
+	unsigned int i;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		__m256i h = _mm256_loadu_si256((const __m256i *)(have + i));
+		__m256i w = _mm256_loadu_si256((const __m256i *)(want + i));
+		__m256i ok = _mm256_or_si256(_mm256_cmpeq_epi8(h, w), _mm256_cmpeq_epi8(h, ff));
+		if (_mm256_movemask_epi8(ok) != -1)
+			return 1;
+	}
+	return scalar_need_bytes(have + i, want + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static unsigned int avx2_find(const uint8_t *a, const uint8_t *b, unsigned int len, int equal)
+{
+	const uint32_t skip = equal ? 0 : 0xffffffff;
+	unsigned int i;
+	uint32_t mask;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)) ^ skip;
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+	return i + scalar_find(a + i, b + i, len - i, equal);
+}
+
+__attribute__((target("avx2,popcnt")))
+static unsigned int avx2_count_diff(const uint8_t *a, const uint8_t *b, unsigned int len)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		count += 32 - __builtin_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+	}
+	return count + scalar_count_diff(a + i, b + i, len - i);
+}
+
+static const struct memops avx2_ops = {
+	.name		= "AVX2",
+	.is_erased	= avx2_is_erased,
+	.need_bits	= avx2_need_bits,
+	.need_bytes	= avx2_need_bytes,
+	.find		= avx2_find,
+	.count_diff	= avx2_count_diff,
+};
+#endif
+
+static const struct memops *ops = NULL;
+
+static const struct memops *get_memops(void)
+{
+	if (ops)
+		return ops;
+	ops = &scalar_ops;
+#if MEMOPS_X86
+	__builtin_cpu_init();
+	/* The popcount variants are only used together with the vector code, require POPCNT for both. */
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+		ops = &avx2_ops;
+	else if (__builtin_cpu_supports("sse2") && __builtin_cpu_supports("popcnt"))
+		ops = &sse2_ops;
+#endif
+	msg_gspew("Using %s buffer scanning.\n", ops->name);
+	return ops;
+}
+
+/* Returns 1 if all @len bytes of @buf are 0xff, 0 otherwise. */
+int mem_is_erased(const uint8_t *buf, unsigned int len)
+{
+	return get_memops()->is_erased(buf, len);
+}
+
+/* Returns 1 if any bit set in @want is cleared in @have, i.e. if @want can not be programmed on top of @have
+ * by clearing bits, 0 otherwise.
+ */
+int mem_need_erase_bits(const uint8_t *have, const uint8_t *want, unsigned int len)
+{
+	return get_memops()->need_bits(have, want, len);
+}
+
+/* Returns 1 if any byte differs between @have and @want while not being 0xff in @have, 0 otherwise. */
+int mem_need_erase_bytes(const uint8_t *have, const uint8_t *want, unsigned int len)
+{
+	return get_memops()->need_bytes(have, want, len);
+}
+
+/* Returns the offset of the first byte differing between @a and @b, or @len if there is none. */
+unsigned int mem_first_diff(const uint8_t *a, const uint8_t *b, unsigned int len)
+{
+	return get_memops()->find(a, b, len, 0);
+}
+
+/* Returns the offset of the first byte that is equal in @a and @b, or @len if there is none. */
+unsigned int mem_first_same(const uint8_t *a, const uint8_t *b, unsigned int len)
+{
+	return get_memops()->find(a, b, len, 1);
+}
+
+/* Returns the number of bytes differing between @a and @b. */
+unsigned int mem_count_diff(const uint8_t *a, const uint8_t *b, unsigned int len)
+{
+	return get_memops()->count_diff(a, b, len);
+}
@@ -605,16 +605,62 @@ enum spi_controller {
 #define MAX_DATA_UNSPECIFIED 0
 #define MAX_DATA_READ_UNLIMITED 64 * 1024
 #define MAX_DATA_WRITE_UNLIMITED 256
+
+/* The read and write_256 functions of the master send 4-byte addresses where needed. Masters without this flag
+ * use spi_read_chunked() and spi_write_chunked() instead unless their functions are these very defaults. */
+#define SPI_MASTER_4BA	(1 << 0)
+
+/* Multi I/O read and program modes, named after the number of lines used for opcode, address and data. */
+#define SPI_IO_1_1_2	(1 << 0)
+#define SPI_IO_1_2_2	(1 << 1)
+#define SPI_IO_1_1_4	(1 << 2)
+#define SPI_IO_1_4_4	(1 << 3)
+
+/* A read command using one of the multi I/O modes. */
+struct spi_multi_io_read {
+	unsigned int io_mode;		/* One of SPI_IO_* */
+	uint8_t opcode;
+	unsigned int addr;
+	unsigned int addr_len;		/* 3 or 4 bytes */
+	unsigned int dummy_clocks;	/* Clock cycles between address and data, I/O lines are driven high. */
+};
+/* A page program command using one of the quad modes. */
+struct spi_multi_io_write {
+	unsigned int io_mode;		/* SPI_IO_1_1_4 or SPI_IO_1_4_4 */
+	uint8_t opcode;
+	unsigned int addr;
+	unsigned int addr_len;		/* 3 or 4 bytes */
+};
 struct spi_master {
 	enum spi_controller type;
 	unsigned int max_data_read; // (Ideally,) maximum data read size in one go (excluding opcode+address).
 	unsigned int max_data_write; // (Ideally,) maximum data write size in one go (excluding opcode+address).
+	unsigned int clock_khz; // SPI clock used for the chip in kHz, 0 if unknown.
+	unsigned int io_modes; // SPI_IO_* modes supported by read_multi_io and write_multi_io.
+	unsigned int features; // SPI_MASTER_* flags.
 	int (*command)(struct flashctx *flash, unsigned int writecnt, unsigned int readcnt,
 		   const unsigned char *writearr, unsigned char *readarr);
 	int (*multicommand)(struct flashctx *flash, struct spi_command *cmds);
+	/* Send cmds and read the status register count times into status: delay_us after the last command and
+	 * step_us apart after that. Masters implement this to do all of it in a single bus transaction. Returns
+	 * SPI_INVALID_OPCODE without sending anything if that is not possible. */
+	int (*multicommand_poll)(struct flashctx *flash, struct spi_command *cmds, unsigned int delay_us,
+				 unsigned int step_us, unsigned int count, uint8_t *status);
+	/* Queue req and return without waiting for it. Requests execute in the order they were submitted, and
+	 * every other hook completes all outstanding requests before it does anything else. complete() sets done on the
+	 * requests that have finished since the last call; with wait set it returns only once req is done.
+	 * Errors are reported in req->result, a failing queue ends all outstanding requests with an error. */
+	int (*submit)(struct flashctx *flash, struct spi_async *req);
+	void (*complete)(struct flashctx *flash, struct spi_async *req, bool wait);
 
 	/* Optimized functions for this master */
 	int (*read)(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len);
+	/* Read len bytes starting at cmd->addr, splitting it into several commands as needed. */
+	int (*read_multi_io)(struct flashctx *flash, const struct spi_multi_io_read *cmd, uint8_t *buf,
+			     unsigned int len);
+	/* Send a single program command with len bytes (at most one page). WREN was already sent. */
+	int (*write_multi_io)(struct flashctx *flash, const struct spi_multi_io_write *cmd, const uint8_t *buf,
+			      unsigned int len);
 	int (*write_256)(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len);
 	int (*write_aai)(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len);
 	const void *data;
@@ -429,6 +429,27 @@ static const struct par_master par_master_serprog = {
 
 static enum chipbustype serprog_buses_supported = BUS_NONE;
 
+/* Returns the SPI clock in Hz the programmer actually set when asked for f_spi_req Hz, or 0 on failure. */
+static uint32_t sp_set_spi_freq(uint32_t f_spi_req)
+{
+	uint8_t buf[4];
+	uint32_t f_spi;
+
+	buf[0] = (f_spi_req >> (0 * 8)) & 0xFF;
+	buf[1] = (f_spi_req >> (1 * 8)) & 0xFF;
+	buf[2] = (f_spi_req >> (2 * 8)) & 0xFF;
+	buf[3] = (f_spi_req >> (3 * 8)) & 0xFF;
+	if (sp_docommand(S_CMD_S_SPI_FREQ, 4, buf, 4, buf))
+		return 0;
+	f_spi = buf[0];
+	f_spi |= buf[1] << (1 * 8);
+	f_spi |= buf[2] << (2 * 8);
+	f_spi |= buf[3] << (3 * 8);
+	msg_pdbg(MSGHEADER "Requested to set SPI clock frequency to %u Hz. "
+		 "It was actually set to %u Hz\n", f_spi_req, f_spi);
+	return f_spi;
+}
+
 int serprog_init(void)
 {
 	uint16_t iface;
@@ -609,7 +630,6 @@ int serprog_init(void)
 		spispeed = extract_programmer_param("spispeed");
 		if (spispeed && strlen(spispeed)) {
 			uint32_t f_spi_req, f_spi;
-			uint8_t buf[4];
 			char *f_spi_suffix;
 
 			errno = 0;
@@ -635,21 +655,11 @@ int serprog_init(void)
 				return 1;
 			}
 
-			buf[0] = (f_spi_req >> (0 * 8)) & 0xFF;
-			buf[1] = (f_spi_req >> (1 * 8)) & 0xFF;
-			buf[2] = (f_spi_req >> (2 * 8)) & 0xFF;
-			buf[3] = (f_spi_req >> (3 * 8)) & 0xFF;
-
 			if (sp_check_commandavail(S_CMD_S_SPI_FREQ) == 0)
 				msg_pwarn(MSGHEADER "Warning: Setting the SPI clock rate is not supported!\n");
-			else if (sp_docommand(S_CMD_S_SPI_FREQ, 4, buf, 4, buf) == 0) {
-				f_spi = buf[0];
-				f_spi |= buf[1] << (1 * 8);
-				f_spi |= buf[2] << (2 * 8);
-				f_spi |= buf[3] << (3 * 8);
-				msg_pdbg(MSGHEADER "Requested to set SPI clock frequency to %u Hz. "
-					 "It was actually set to %u Hz\n", f_spi_req, f_spi);
-			} else
+			else if ((f_spi = sp_set_spi_freq(f_spi_req)))
+				spi_master_serprog.clock_khz = f_spi / 1000;
+			else
 				msg_pwarn(MSGHEADER "Setting SPI clock rate to %u Hz failed!\n", f_spi_req);
 		}
 		free(spispeed);
@@ -1117,6 +1127,18 @@ static int serprog_spi_read(struct flashctx *flash, uint8_t *buf,
 {
 	unsigned int i, cur_len;
 	const unsigned int max_read = spi_master_serprog.max_data_read;
+	const unsigned int max_khz = spi_max_read_khz(flash);
+	uint32_t f_spi;
+
+	/* The clock is only known if it was set with spispeed. */
+	if (max_khz && flash->mst->spi.clock_khz > max_khz) {
+		f_spi = sp_set_spi_freq(max_khz * 1000);
+		if (!f_spi) {
+			msg_perr(MSGHEADER "Lowering the SPI clock to %u kHz failed!\n", max_khz);
+			return 1;
+		}
+		flash->mst->spi.clock_khz = f_spi / 1000;
+	}
 	for (i = 0; i < len; i += cur_len) {
 		int ret;
 		cur_len = min(max_read, (len - i));
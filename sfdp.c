@@ -17,6 +17,7 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -125,17 +126,200 @@ static int sfdp_add_uniform_eraser(struct flashchip *chip, uint8_t opcode, uint3
 	return 1;
 }
 
+/* Returns the little-endian double word number @n (counting from 1 like JESD216 does) of a parameter table. */
+static uint32_t sfdp_dword(const uint8_t *buf, unsigned int n)
+{
+	buf += 4 * (n - 1);
+	return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+/* Stores the opcode and dummy clocks of a multi I/O read found in double words 3 and 4. @field points to the
+ * wait states (bits 4:0) and mode clocks (bits 7:5), followed by the opcode. @idx is the position in the
+ * multi_io_reads array of struct flashchip.
+ */
+static void sfdp_set_read_mode(struct flashchip *chip, int feature, unsigned int idx, const char *name,
+			       const uint8_t *field)
+{
+	if (!(chip->feature_bits & feature))
+		return;
+	chip->multi_io_reads[idx].opcode = field[1];
+	chip->multi_io_reads[idx].dummy_clocks = (field[0] & 0x1F) + (field[0] >> 5);
+	msg_cdbg2("  %s read uses opcode 0x%02x with %d dummy clocks.\n", name,
+		  chip->multi_io_reads[idx].opcode, chip->multi_io_reads[idx].dummy_clocks);
+}
+
+/* Converts a typical time field with a count in the lower bits and a unit selector above them. */
+static uint32_t sfdp_time(uint32_t field, unsigned int count_bits, const uint32_t *units)
+{
+	return ((field & ((1 << count_bits) - 1)) + 1) * units[field >> count_bits];
+}
+
+/* Parses the typical erase and program times in double words 10 and 11 of JESD216A and later. The maximum
+ * times are given as a common multiplier of the typical ones for erases and programs respectively.
+ */
+static void sfdp_fill_timing(struct flashchip *chip, const uint8_t *buf, const uint32_t *erase_sizes)
+{
+	static const uint32_t erase_units[] = { 1000, 16 * 1000, 128 * 1000, 1000 * 1000 };
+	static const uint32_t page_units[] = { 8, 64 };
+	static const uint32_t byte_units[] = { 1, 8 };
+	static const uint32_t chip_units[] = { 16 * 1000, 256 * 1000, 4 * 1000 * 1000, 64 * 1000 * 1000 };
+	struct chip_timing *timing = &chip->timing;
+	struct op_timing *t;
+	uint32_t dw10, dw11;
+	unsigned int mult;
+	uint64_t tmp64;
+	int j;
+
+	dw10 = sfdp_dword(buf, 10);
+	dw11 = sfdp_dword(buf, 11);
+	if (dw10 == 0xFFFFFFFF || dw11 == 0xFFFFFFFF) {
+		msg_cdbg2("  Erase and program times are not defined.\n");
+		return;
+	}
+
+	mult = 2 * ((dw10 & 0xF) + 1);
+	for (j = 0; j < 4; j++) {
+		switch (erase_sizes[j]) {
+		case 4 * 1024:
+			t = &timing->sector_erase;
+			break;
+		case 32 * 1024:
+			t = &timing->block32_erase;
+			break;
+		case 64 * 1024:
+			t = &timing->block64_erase;
+			break;
+		default:
+			continue;
+		}
+		t->typ = sfdp_time((dw10 >> (4 + 7 * j)) & 0x7F, 5, erase_units);
+		t->max = t->typ * mult;
+		msg_cdbg2("  Erasing %d kB takes %u ms (max. %u ms).\n", erase_sizes[j] / 1024,
+			  t->typ / 1000, t->max / 1000);
+	}
+
+	mult = 2 * ((dw11 & 0xF) + 1);
+	timing->page_program.typ = sfdp_time((dw11 >> 8) & 0x3F, 5, page_units);
+	timing->page_program.max = timing->page_program.typ * mult;
+	timing->byte_program.typ = sfdp_time((dw11 >> 14) & 0x1F, 4, byte_units);
+	timing->byte_program.max = timing->byte_program.typ * mult;
+	timing->chip_erase.typ = sfdp_time((dw11 >> 24) & 0x7F, 5, chip_units);
+	/* The chip erase shares its multiplier with the other erases. */
+	tmp64 = (uint64_t)timing->chip_erase.typ * 2 * ((dw10 & 0xF) + 1);
+	timing->chip_erase.max = (tmp64 > UINT32_MAX / 2) ? UINT32_MAX / 2 : tmp64;
+	msg_cdbg2("  Programming a page takes %u us (max. %u us), a byte %u us (max. %u us).\n",
+		  timing->page_program.typ, timing->page_program.max,
+		  timing->byte_program.typ, timing->byte_program.max);
+	msg_cdbg2("  Erasing the whole chip takes %u ms (max. %u ms).\n",
+		  timing->chip_erase.typ / 1000, timing->chip_erase.max / 1000);
+}
+
+/* Parses the Quad Enable requirements (double word 15) and the ways to enter 4-byte address mode (double word 16)
+ * of JESD216A and later.
+ */
+static void sfdp_fill_modes(struct flashchip *chip, const uint8_t *buf, uint16_t len)
+{
+	uint32_t tmp32;
+
+	if (len < 15 * 4)
+		return;
+	tmp32 = sfdp_dword(buf, 15);
+	switch ((tmp32 >> 20) & 0x7) {
+	case 0x0:
+		msg_cdbg2("  Quad reads need no Quad Enable bit.\n");
+		chip->feature_bits |= FEATURE_QE_NONE;
+		break;
+	case 0x2:
+		msg_cdbg2("  Quad Enable is bit 6 of the status register.\n");
+		chip->feature_bits |= FEATURE_QE_SR1_BIT6;
+		break;
+	/* 0x1 and 0x4 have the same bit, but status register 2 may not be readable with 0x35 then. */
+	case 0x5:
+		msg_cdbg2("  Quad Enable is bit 1 of status register 2.\n");
+		chip->feature_bits |= FEATURE_QE_SR2_BIT1;
+		break;
+	default:
+		msg_cdbg2("  Quad Enable requirements (0x%x) not supported.\n", (tmp32 >> 20) & 0x7);
+		break;
+	}
+
+	if (len < 16 * 4)
+		return;
+	tmp32 = sfdp_dword(buf, 16);
+	/* Only plain 0xB7 without WREN, exiting with 0xE9 is supported. */
+	if ((tmp32 & (1 << 24)) && (tmp32 & (1 << 14))) {
+		msg_cdbg2("  4-byte address mode is entered with 0xB7.\n");
+		chip->feature_bits |= FEATURE_4BA_ENTER;
+	}
+}
+
+/* Parses the 4-byte Address Instruction Table of JESD216B. The native 4-byte address opcodes are only used if
+ * the plain read, fast read, page program and all erasers used have them. Multi I/O reads without a 4-byte
+ * address variant are dropped.
+ */
+static void sfdp_fill_4ba(struct flashchip *chip, uint32_t dw1, uint32_t dw2)
+{
+	static const struct {
+		int feature;
+		int bit;
+	} reads[] = {
+		{ FEATURE_IO_1_1_2, 2 },
+		{ FEATURE_IO_1_2_2, 3 },
+		{ FEATURE_IO_1_1_4, 4 },
+		{ FEATURE_IO_1_4_4, 5 },
+	};
+	uint8_t op_4ba;
+	int i, j;
+
+	msg_cdbg2("Parsing 4-byte address instruction table...\n");
+	if ((dw1 & 0x43) != 0x43) {
+		msg_cdbg2("  Read, fast read or page program with 4-byte addresses are missing.\n");
+		return;
+	}
+	for (i = 0; i < NUM_ERASEFUNCTIONS; i++) {
+		erasefunc_t *erasefn = chip->block_erasers[i].block_erase;
+
+		if (!erasefn || erasefn == spi_block_erase_60 || erasefn == spi_block_erase_c7)
+			continue;
+		if (erasefn == spi_block_erase_20)
+			op_4ba = JEDEC_SE_4BA;
+		else if (erasefn == spi_block_erase_52)
+			op_4ba = JEDEC_BE_5C;
+		else if (erasefn == spi_block_erase_d8)
+			op_4ba = JEDEC_BE_DC;
+		else
+			op_4ba = 0;
+		for (j = 0; op_4ba && j < 4; j++)
+			if ((dw1 & (1 << (9 + j))) && ((dw2 >> (8 * j)) & 0xFF) == op_4ba)
+				break;
+		if (!op_4ba || j == 4) {
+			msg_cdbg2("  Block eraser %d has no 4-byte address variant.\n", i);
+			return;
+		}
+	}
+	for (i = 0; i < ARRAY_SIZE(reads); i++) {
+		if ((chip->feature_bits & reads[i].feature) && !(dw1 & (1 << reads[i].bit))) {
+			msg_cdbg2("  Multi I/O read %d has no 4-byte address variant, not using it.\n", i);
+			chip->feature_bits &= ~reads[i].feature;
+		}
+	}
+	msg_cdbg2("  Using native 4-byte address opcodes.\n");
+	chip->feature_bits |= FEATURE_4BA_NATIVE;
+}
+
 static int sfdp_fill_flash(struct flashchip *chip, uint8_t *buf, uint16_t len)
 {
 	uint8_t opcode_4k_erase = 0xFF;
+	uint8_t addr_mode;
 	uint32_t tmp32;
 	uint8_t tmp8;
 	uint32_t total_size; /* in bytes */
 	uint32_t block_size;
+	uint32_t erase_sizes[4] = { 0 };
 	int j;
 
 	msg_cdbg("Parsing JEDEC flash parameter table... ");
-	if (len != 9 * 4 && len != 4 * 4) {
+	if (len < 9 * 4 && len != 4 * 4) {
 		msg_cdbg("%s: len out of spec\n", __func__);
 		return 1;
 	}
@@ -147,7 +331,7 @@ static int sfdp_fill_flash(struct flashchip *chip, uint8_t *buf, uint16_t len)
 	tmp32 |= ((unsigned int)buf[(4 * 0) + 2]) << 16;
 	tmp32 |= ((unsigned int)buf[(4 * 0) + 3]) << 24;
 
-	tmp8 = (tmp32 >> 17) & 0x3;
+	addr_mode = tmp8 = (tmp32 >> 17) & 0x3;
 	switch (tmp8) {
 	case 0x0:
 		msg_cdbg2("  3-Byte only addressing.\n");
@@ -182,6 +366,20 @@ static int sfdp_fill_flash(struct flashchip *chip, uint8_t *buf, uint16_t len)
 			  "status register writes - assuming EWSR.\n");
 			chip->feature_bits = FEATURE_WRSR_EWSR;
 		}
+	/* JESD216 makes Fast Read (1-1-1) mandatory for all chips with SFDP. */
+	chip->feature_bits |= FEATURE_FAST_READ;
+	/* Quad reads are only used if the location of the Quad Enable bit is known as well. */
+	if (tmp32 & (1 << 16))
+		chip->feature_bits |= FEATURE_IO_1_1_2;
+	if (tmp32 & (1 << 20))
+		chip->feature_bits |= FEATURE_IO_1_2_2;
+	if (tmp32 & (1 << 21))
+		chip->feature_bits |= FEATURE_IO_1_4_4;
+	if (tmp32 & (1 << 22))
+		chip->feature_bits |= FEATURE_IO_1_1_4;
+	msg_cdbg2("  Multi I/O reads:%s%s%s%s\n", (tmp32 & (1 << 16)) ? " 1-1-2" : "",
+		  (tmp32 & (1 << 20)) ? " 1-2-2" : "", (tmp32 & (1 << 22)) ? " 1-1-4" : "",
+		  (tmp32 & (1 << 21)) ? " 1-4-4" : "");
 
 	msg_cdbg2("  Write chunk size is ");
 	if (tmp32 & (1 << 2)) {
@@ -215,16 +413,17 @@ static int sfdp_fill_flash(struct flashchip *chip, uint8_t *buf, uint16_t len)
 	chip->total_size = total_size / 1024;
 	msg_cdbg2("  Flash chip size is %d kB.\n", chip->total_size);
 	if (total_size > (1 << 24)) {
-		msg_cdbg("Flash chip size is bigger than what 3-Byte addressing "
-			 "can access.\n");
-		return 1;
+		if (addr_mode == 0x0) {
+			msg_cdbg("Flash chip size is bigger than what 3-Byte addressing "
+				 "can access.\n");
+			return 1;
+		}
+		msg_cdbg2("  Flash chip size needs 4-Byte addressing.\n");
 	}
 
 	if (opcode_4k_erase != 0xFF)
 		sfdp_add_uniform_eraser(chip, opcode_4k_erase, 4 * 1024);
 
-	/* FIXME: double words 3-7 contain unused fast read information */
-
 	if (len == 4 * 4) {
 		msg_cdbg("  It seems like this chip supports the preliminary "
 			 "Intel version of SFDP, skipping processing of double "
@@ -232,6 +431,12 @@ static int sfdp_fill_flash(struct flashchip *chip, uint8_t *buf, uint16_t len)
 		goto done;
 	}
 
+	/* 3. and 4. double word: fast read parameters of the multi I/O reads found in the 1. double word */
+	sfdp_set_read_mode(chip, FEATURE_IO_1_4_4, 3, "1-4-4", &buf[(4 * 2) + 0]);
+	sfdp_set_read_mode(chip, FEATURE_IO_1_1_4, 2, "1-1-4", &buf[(4 * 2) + 2]);
+	sfdp_set_read_mode(chip, FEATURE_IO_1_1_2, 0, "1-1-2", &buf[(4 * 3) + 0]);
+	sfdp_set_read_mode(chip, FEATURE_IO_1_2_2, 1, "1-2-2", &buf[(4 * 3) + 2]);
+
 	/* 8. double word */
 	for (j = 0; j < 4; j++) {
 		/* 7 double words from the start + 2 bytes for every eraser */
@@ -248,6 +453,7 @@ static int sfdp_fill_flash(struct flashchip *chip, uint8_t *buf, uint16_t len)
 			continue;
 		}
 		block_size = 1 << (tmp8); /* block_size = 2 ^ field */
+		erase_sizes[j] = block_size;
 
 		tmp8 = buf[(4 * 7) + (j * 2) + 1];
 		msg_cspew("   Erase Sector Type %d Opcode: 0x%02x\n", j + 1,
@@ -255,7 +461,23 @@ static int sfdp_fill_flash(struct flashchip *chip, uint8_t *buf, uint16_t len)
 		sfdp_add_uniform_eraser(chip, tmp8, block_size);
 	}
 
+	if (len >= 11 * 4) {
+		sfdp_fill_timing(chip, buf, erase_sizes);
+		if (chip->write == spi_chip_write_256) {
+			chip->page_size = 1 << ((sfdp_dword(buf, 11) >> 4) & 0xF);
+			msg_cdbg2("  Page size is %d B.\n", chip->page_size);
+		}
+	}
+	sfdp_fill_modes(chip, buf, len);
+
 done:
+	if (!(chip->feature_bits & (FEATURE_QE_NONE | FEATURE_QE_SR1_BIT6 | FEATURE_QE_SR2_BIT1)) &&
+	    (chip->feature_bits & (FEATURE_IO_1_1_4 | FEATURE_IO_1_4_4))) {
+		msg_cdbg2("  Location of the Quad Enable bit is unknown, not using quad reads.\n");
+		chip->feature_bits &= ~(FEATURE_IO_1_1_4 | FEATURE_IO_1_4_4);
+	}
+	/* JESD216 does not list chip erase opcodes, but all chips with SFDP seem to support 0xC7. */
+	sfdp_add_uniform_eraser(chip, 0xC7, total_size);
 	msg_cdbg("done.\n");
 	return 0;
 }
@@ -271,6 +493,8 @@ int probe_spi_sfdp(struct flashctx *flash)
 	struct sfdp_tbl_hdr *hdrs;
 	uint8_t *hbuf;
 	uint8_t *tbuf;
+	uint32_t tbl_4ba[2] = { 0 };
+	bool have_4ba = false;
 
 	if (spi_sfdp_read_sfdp(flash, 0x00, buf, 4)) {
 		msg_cdbg("Receiving SFDP signature failed.\n");
@@ -377,16 +601,30 @@ int probe_spi_sfdp(struct flashctx *flash)
 				msg_cdbg("The chip contains an unknown "
 					  "version of the JEDEC flash "
 					  "parameters table, skipping it.\n");
-			} else if (len != 9 * 4 && len != 4 * 4) {
+			} else if (len < 9 * 4 && len != 4 * 4) {
 				msg_cdbg("Length of the mandatory JEDEC SFDP "
 					 "parameter table is wrong (%d B), "
 					 "skipping it.\n", len);
 			} else if (sfdp_fill_flash(flash->chip, tbuf, len) == 0)
 				ret = 1;
+		} else if (hdrs[i].id == 0x84 && hbuf[(8 * i) + 7] == 0xFF && len >= 2 * 4) {
+			/* 4-byte Address Instruction Table, applied once the chip is known. */
+			tbl_4ba[0] = sfdp_dword(tbuf, 1);
+			tbl_4ba[1] = sfdp_dword(tbuf, 2);
+			have_4ba = true;
 		}
 		free(tbuf);
 	}
 
+	if (ret && flash->chip->total_size * 1024 > (1 << 24)) {
+		if (have_4ba)
+			sfdp_fill_4ba(flash->chip, tbl_4ba[0], tbl_4ba[1]);
+		if (!(flash->chip->feature_bits & (FEATURE_4BA_ENTER | FEATURE_4BA_NATIVE))) {
+			msg_cdbg("No supported way to use 4-byte addresses found.\n");
+			ret = 0;
+		}
+	}
+
 cleanup_hdrs:
 	free(hdrs);
 	free(hbuf);
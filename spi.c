@@ -64,6 +64,34 @@ int default_spi_send_command(struct flashctx *flash, unsigned int writecnt,
 	return spi_send_multicommand(flash, cmd);
 }
 
+int spi_submit(struct flashctx *flash, struct spi_async *req)
+{
+	req->done = false;
+	if (flash->mst->spi.submit)
+		return flash->mst->spi.submit(flash, req);
+
+	/* Masters without a queue of their own finish the request right away. */
+	req->result = spi_send_multicommand(flash, req->cmds);
+	req->done = true;
+	return 0;
+}
+
+/* Returns whether req is done, without waiting for it. */
+bool spi_poll(struct flashctx *flash, struct spi_async *req)
+{
+	if (!req->done)
+		flash->mst->spi.complete(flash, req, false);
+	return req->done;
+}
+
+/* Waits until req is done and returns its result. */
+int spi_wait(struct flashctx *flash, struct spi_async *req)
+{
+	if (!req->done)
+		flash->mst->spi.complete(flash, req, true);
+	return req->result;
+}
+
 int default_spi_send_multicommand(struct flashctx *flash,
 				  struct spi_command *cmds)
 {
@@ -71,6 +99,8 @@ int default_spi_send_multicommand(struct flashctx *flash,
 	for (; (cmds->writecnt || cmds->readcnt) && !result; cmds++) {
 		result = spi_send_command(flash, cmds->writecnt, cmds->readcnt,
 					  cmds->writearr, cmds->readarr);
+		if (!result && cmds->delay_us)
+			programmer_delay(cmds->delay_us);
 	}
 	return result;
 }
@@ -107,10 +137,11 @@ int spi_chip_read(struct flashctx *flash, uint8_t *buf, unsigned int start,
 
 	/* Check if the chip fits between lowest valid and highest possible
 	 * address. Highest possible address with the current SPI implementation
-	 * means 0xffffff, the highest unsigned 24bit number.
+	 * means 0xffffff, the highest unsigned 24bit number, unless 4-byte
+	 * addresses are used.
 	 */
 	addrbase = spi_get_valid_read_addr(flash);
-	if (addrbase + flash->chip->total_size * 1024 > (1 << 24)) {
+	if (!spi_chip_4ba(flash) && addrbase + flash->chip->total_size * 1024 > (1 << 24)) {
 		msg_perr("Flash chip size exceeds the allowed access window. ");
 		msg_perr("Read will probably fail.\n");
 		/* Try to get the best alignment subject to constraints. */
@@ -124,6 +155,14 @@ int spi_chip_read(struct flashctx *flash, uint8_t *buf, unsigned int start,
 			 "access window.\n");
 		msg_perr("Read will probably return garbage.\n");
 	}
+	if (flash->mst->spi.io_modes) {
+		int ret = spi_read_multi_io(flash, buf, addrbase + start, len);
+		if (ret != SPI_INVALID_OPCODE)
+			return ret;
+	}
+	/* Optimized read functions may hard-code 3-byte addresses and would wrap around at 16 MiB. */
+	if (spi_chip_4ba(flash) && !(flash->mst->spi.features & SPI_MASTER_4BA))
+		return default_spi_read(flash, buf, addrbase + start, len);
 	return flash->mst->spi.read(flash, buf, addrbase + start, len);
 }
 
@@ -136,7 +175,13 @@ int spi_chip_read(struct flashctx *flash, uint8_t *buf, unsigned int start,
 /* real chunksize is up to 256, logical chunksize is 256 */
 int spi_chip_write_256(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
 {
-	return flash->mst->spi.write_256(flash, buf, start, len);
+	const struct spi_master *mst = &flash->mst->spi;
+
+	/* Like for reads, only the generic functions are known to handle 4-byte addresses. */
+	if (spi_chip_4ba(flash) && !(mst->features & SPI_MASTER_4BA) &&
+	    mst->write_256 != default_spi_write_256 && mst->write_256 != spi_chip_write_1)
+		return default_spi_write_256(flash, buf, start, len);
+	return mst->write_256(flash, buf, start, len);
 }
 
 /*
@@ -170,7 +215,7 @@ int register_spi_master(const struct spi_master *mst)
 	struct registered_master rmst;
 
 	if (!mst->write_aai || !mst->write_256 || !mst->read || !mst->command ||
-	    !mst->multicommand ||
+	    !mst->multicommand || (!mst->submit != !mst->complete) ||
 	    ((mst->command == default_spi_send_command) &&
 	     (mst->multicommand == default_spi_send_multicommand))) {
 		msg_perr("%s called with incomplete master definition. "
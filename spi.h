@@ -111,6 +111,16 @@
 #define JEDEC_SE_OUTSIZE	0x04
 #define JEDEC_SE_INSIZE		0x00
 
+/* Sector Erase and Block Erase with 4-byte addresses */
+#define JEDEC_SE_4BA		0x21
+#define JEDEC_BE_5C		0x5c
+#define JEDEC_BE_DC		0xdc
+
+/* Enter/exit 4-byte address mode, in which all commands take 4-byte addresses */
+#define JEDEC_ENTER_4_BYTE_ADDR_MODE	0xb7
+#define JEDEC_EXIT_4_BYTE_ADDR_MODE	0xe9
+#define JEDEC_ENTER_EXIT_4BA_OUTSIZE	0x01
+
 /* Page Erase 0xDB */
 #define JEDEC_PE		0xDB
 #define JEDEC_PE_OUTSIZE	0x04
@@ -121,6 +131,11 @@
 #define JEDEC_RDSR_OUTSIZE	0x01
 #define JEDEC_RDSR_INSIZE	0x01
 
+/* Read Status Register 2 (Winbond and compatible) */
+#define JEDEC_RDSR2		0x35
+#define JEDEC_RDSR2_OUTSIZE	0x01
+#define JEDEC_RDSR2_INSIZE	0x01
+
 /* Status Register Bits */
 #define SPI_SR_WIP	(0x01 << 0)
 #define SPI_SR_WEL	(0x01 << 1)
@@ -141,11 +156,42 @@
 #define JEDEC_READ_OUTSIZE	0x04
 /*      JEDEC_READ_INSIZE : any length */
 
+/* Read the memory at higher clock rates, followed by one dummy byte */
+#define JEDEC_FAST_READ		0x0b
+#define JEDEC_FAST_READ_OUTSIZE	0x05
+/*      JEDEC_FAST_READ_INSIZE : any length */
+
+/* Multi I/O reads, named after the number of lines used for opcode, address and data */
+#define JEDEC_READ_1_1_2	0x3b
+#define JEDEC_READ_1_2_2	0xbb
+#define JEDEC_READ_1_1_4	0x6b
+#define JEDEC_READ_1_4_4	0xeb
+
+/* Reads with 4-byte addresses */
+#define JEDEC_READ_4BA		0x13
+#define JEDEC_FAST_READ_4BA	0x0c
+#define JEDEC_READ_1_1_2_4BA	0x3c
+#define JEDEC_READ_1_2_2_4BA	0xbc
+#define JEDEC_READ_1_1_4_4BA	0x6c
+#define JEDEC_READ_1_4_4_4BA	0xec
+
+/* Longest address of any command */
+#define JEDEC_MAX_ADDR_LEN	0x04
+
 /* Write memory byte */
 #define JEDEC_BYTE_PROGRAM		0x02
 #define JEDEC_BYTE_PROGRAM_OUTSIZE	0x05
 #define JEDEC_BYTE_PROGRAM_INSIZE	0x00
 
+/* Write memory byte(s) with a 4-byte address */
+#define JEDEC_BYTE_PROGRAM_4BA		0x12
+
+/* Quad Input Page Program (1-1-4) and Quad I/O Page Program (1-4-4, Macronix 4PP) */
+#define JEDEC_PP_1_1_4		0x32
+#define JEDEC_PP_1_4_4		0x38
+#define JEDEC_PP_1_1_4_4BA	0x34
+#define JEDEC_PP_1_4_4_4BA	0x3e
+
 /* Write AAI word (SST25VF080B) */
 #define JEDEC_AAI_WORD_PROGRAM			0xad
 #define JEDEC_AAI_WORD_PROGRAM_OUTSIZE		0x06
@@ -23,6 +23,7 @@
  */
 
 #include <string.h>
+#include <strings.h>
 #include "flash.h"
 #include "flashchips.h"
 #include "chipdrivers.h"
@@ -321,6 +322,193 @@ int probe_spi_at25f(struct flashctx *flash)
 	return 0;
 }
 
+/* Typical and maximum durations of self-timed operations used if nothing better is known. The timeouts are
+ * generous because worn out chips can be a lot slower than their datasheet claims.
+ */
+#define SPI_BYTE_PROGRAM_TYP	10
+#define SPI_BYTE_PROGRAM_MAX	10
+#define SPI_PAGE_PROGRAM_TYP	700
+#define SPI_PROGRAM_TIMEOUT	(100 * 1000)
+
+/* A chip erase usually takes about 2.5 ms per kB. */
+static unsigned int spi_chip_erase_typ(const struct flashctx *flash)
+{
+	return flash->chip->total_size * 2500;
+}
+
+static unsigned int spi_chip_erase_timeout(const struct flashctx *flash)
+{
+	return max(200 * 1000 * 1000, flash->chip->total_size * 25 * 1000);
+}
+
+/* Send @cmds (if not NULL) and wait for the operation described by the datasheet timing @t of the chip. @typ_us
+ * and @timeout_us are used where the timing is unknown. Worn out chips may exceed the specified maximum, hence we
+ * allow twice as long.
+ */
+static int spi_send_multicommand_timed(struct flashctx *flash, struct spi_command *cmds, enum spi_wait_op op,
+				       const struct op_timing *t, unsigned int typ_us, unsigned int timeout_us)
+{
+	if (t->typ)
+		typ_us = t->typ;
+	if (t->max)
+		timeout_us = 2 * t->max;
+	return spi_send_multicommand_wait(flash, cmds, op, typ_us, timeout_us);
+}
+
+static int spi_wait_timed(struct flashctx *flash, enum spi_wait_op op, const struct op_timing *t,
+			  unsigned int typ_us, unsigned int timeout_us)
+{
+	return spi_send_multicommand_timed(flash, NULL, op, t, typ_us, timeout_us);
+}
+
+/* How spi_write_cmd_wait() waits for the command to finish, see spi_wait_timed(). */
+struct spi_write_wait {
+	enum spi_wait_op op;
+	const struct op_timing *timing;
+	unsigned int typ_us;
+	unsigned int timeout_us;
+};
+
+/* Chips bigger than 16 MiB need 4-byte addresses for at least a part of their contents. */
+static bool spi_chip_needs_4ba(const struct flashctx *flash)
+{
+	return flash->chip->total_size * 1024 > (1 << 24);
+}
+
+/*
+ * Returns true if commands carry 4-byte addresses, either because the chip was switched to 4-byte address mode
+ * or because its native 4-byte address opcodes are used.
+ */
+bool spi_chip_4ba(const struct flashctx *flash)
+{
+	return flash->in_4ba_mode ||
+	       (spi_chip_needs_4ba(flash) && (flash->chip->feature_bits & FEATURE_4BA_NATIVE));
+}
+
+/*
+ * Store the opcode and address of a command in @cmd and return the length of the address. If 4-byte addresses
+ * are used, @op takes them in 4-byte address mode, otherwise the native 4-byte address opcode @op_4ba is sent.
+ * Returns -1 if the address can not be sent.
+ */
+static int spi_prepare_address(struct flashctx *flash, uint8_t *cmd, uint8_t op, uint8_t op_4ba,
+			       unsigned int addr)
+{
+	if (!spi_chip_4ba(flash)) {
+		if (addr > 0xffffff) {
+			msg_cerr("Address 0x%x needs 4-byte addressing which is not supported for this chip.\n",
+				 addr);
+			return -1;
+		}
+		cmd[0] = op;
+		cmd[1] = (addr >> 16) & 0xff;
+		cmd[2] = (addr >> 8) & 0xff;
+		cmd[3] = (addr >> 0) & 0xff;
+		return 3;
+	}
+	if (!flash->in_4ba_mode) {
+		if (!op_4ba) {
+			msg_cerr("Opcode 0x%02x has no 4-byte address variant.\n", op);
+			return -1;
+		}
+		op = op_4ba;
+	}
+	cmd[0] = op;
+	cmd[1] = (addr >> 24) & 0xff;
+	cmd[2] = (addr >> 16) & 0xff;
+	cmd[3] = (addr >> 8) & 0xff;
+	cmd[4] = (addr >> 0) & 0xff;
+	return 4;
+}
+
+/*
+ * Send WREN followed by @op (or its 4-byte address variant @op_4ba, see spi_prepare_address()) with the address
+ * @addr and @len bytes of @data. If @wait is not NULL, wait for the command to finish. Masters that can do so
+ * send the commands and poll the status register in a single transaction then.
+ */
+static int spi_write_cmd_wait(struct flashctx *flash, uint8_t op, uint8_t op_4ba, unsigned int addr,
+			      const uint8_t *data, unsigned int len, const struct spi_write_wait *wait)
+{
+	/* FIXME: Switch to malloc based on len unless that kills speed. */
+	unsigned char cmd[1 + JEDEC_MAX_ADDR_LEN + 256];
+	int addr_len;
+	struct spi_command cmds[] = {
+	{
+		.writecnt	= JEDEC_WREN_OUTSIZE,
+		.writearr	= (const unsigned char[]){ JEDEC_WREN },
+		.readcnt	= 0,
+		.readarr	= NULL,
+	}, {
+		.writecnt	= 0, /* Set below. */
+		.writearr	= cmd,
+		.readcnt	= 0,
+		.readarr	= NULL,
+	}, {
+		.writecnt	= 0,
+		.writearr	= NULL,
+		.readcnt	= 0,
+		.readarr	= NULL,
+	}};
+
+	if (len > 256) {
+		msg_cerr("%s called for too long a write\n", __func__);
+		return 1;
+	}
+	addr_len = spi_prepare_address(flash, cmd, op, op_4ba, addr);
+	if (addr_len < 0)
+		return 1;
+	if (len)
+		memcpy(cmd + 1 + addr_len, data, len);
+	cmds[1].writecnt = 1 + addr_len + len;
+	if (!wait)
+		return spi_send_multicommand(flash, cmds);
+	return spi_send_multicommand_timed(flash, cmds, wait->op, wait->timing, wait->typ_us, wait->timeout_us);
+}
+
+static int spi_write_cmd(struct flashctx *flash, uint8_t op, uint8_t op_4ba, unsigned int addr,
+			 const uint8_t *data, unsigned int len)
+{
+	return spi_write_cmd_wait(flash, op, op_4ba, addr, data, len, NULL);
+}
+
+/*
+ * Make the whole chip addressable. Chips up to 16 MiB and chips with native 4-byte address opcodes are left
+ * alone, all others are switched to 4-byte address mode until spi_exit_4ba() is called.
+ */
+int spi_enter_4ba(struct flashctx *flash)
+{
+	static const unsigned char cmd[JEDEC_ENTER_EXIT_4BA_OUTSIZE] = { JEDEC_ENTER_4_BYTE_ADDR_MODE };
+
+	if (!spi_chip_needs_4ba(flash) || (flash->chip->feature_bits & FEATURE_4BA_NATIVE))
+		return 0;
+	if (!(flash->chip->feature_bits & FEATURE_4BA_ENTER)) {
+		msg_cwarn("This chip needs 4-byte addressing beyond 16 MiB, but no way to enable it is known.\n"
+			  "Only the first 16 MiB are accessible.\n");
+		return 0;
+	}
+	if (spi_send_command(flash, sizeof(cmd), 0, cmd, NULL)) {
+		msg_cerr("Entering 4-byte address mode failed.\n");
+		return 1;
+	}
+	msg_cdbg("Entered 4-byte address mode.\n");
+	flash->in_4ba_mode = true;
+	return 0;
+}
+
+int spi_exit_4ba(struct flashctx *flash)
+{
+	static const unsigned char cmd[JEDEC_ENTER_EXIT_4BA_OUTSIZE] = { JEDEC_EXIT_4_BYTE_ADDR_MODE };
+
+	if (!flash->in_4ba_mode)
+		return 0;
+	flash->in_4ba_mode = false;
+	if (spi_send_command(flash, sizeof(cmd), 0, cmd, NULL)) {
+		msg_cerr("Leaving 4-byte address mode failed.\n");
+		return 1;
+	}
+	msg_cdbg("Left 4-byte address mode.\n");
+	return 0;
+}
+
 int spi_chip_erase_60(struct flashctx *flash)
 {
 	int result;
@@ -349,13 +537,11 @@ int spi_chip_erase_60(struct flashctx *flash)
 		return result;
 	}
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This usually takes 1-85 s, so wait in 1 s steps.
+	 * This usually takes 1-85 s.
 	 */
-	/* FIXME: We assume spi_read_status_register will never fail. */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(1000 * 1000);
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_timed(flash, SPI_WAIT_CHIP_ERASE, &flash->chip->timing.chip_erase,
+			      spi_chip_erase_typ(flash), spi_chip_erase_timeout(flash));
 }
 
 int spi_chip_erase_62(struct flashctx *flash)
@@ -386,13 +572,11 @@ int spi_chip_erase_62(struct flashctx *flash)
 		return result;
 	}
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This usually takes 2-5 s, so wait in 100 ms steps.
+	 * This usually takes 2-5 s.
 	 */
-	/* FIXME: We assume spi_read_status_register will never fail. */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(100 * 1000);
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_timed(flash, SPI_WAIT_CHIP_ERASE, &flash->chip->timing.chip_erase,
+			      2 * 1000 * 1000, spi_chip_erase_timeout(flash));
 }
 
 int spi_chip_erase_c7(struct flashctx *flash)
@@ -422,55 +606,30 @@ int spi_chip_erase_c7(struct flashctx *flash)
 		return result;
 	}
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This usually takes 1-85 s, so wait in 1 s steps.
+	 * This usually takes 1-85 s.
 	 */
-	/* FIXME: We assume spi_read_status_register will never fail. */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(1000 * 1000);
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_timed(flash, SPI_WAIT_CHIP_ERASE, &flash->chip->timing.chip_erase,
+			      spi_chip_erase_typ(flash), spi_chip_erase_timeout(flash));
 }
 
 int spi_block_erase_52(struct flashctx *flash, unsigned int addr,
 		       unsigned int blocklen)
 {
 	int result;
-	struct spi_command cmds[] = {
-	{
-		.writecnt	= JEDEC_WREN_OUTSIZE,
-		.writearr	= (const unsigned char[]){ JEDEC_WREN },
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= JEDEC_BE_52_OUTSIZE,
-		.writearr	= (const unsigned char[]){
-					JEDEC_BE_52,
-					(addr >> 16) & 0xff,
-					(addr >> 8) & 0xff,
-					(addr & 0xff)
-				},
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= 0,
-		.writearr	= NULL,
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}};
 
-	result = spi_send_multicommand(flash, cmds);
+	result = spi_write_cmd(flash, JEDEC_BE_52, JEDEC_BE_5C, addr, NULL, 0);
 	if (result) {
 		msg_cerr("%s failed during command execution at address 0x%x\n",
 			__func__, addr);
 		return result;
 	}
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This usually takes 100-4000 ms, so wait in 100 ms steps.
+	 * This usually takes 100-4000 ms.
 	 */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(100 * 1000);
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_timed(flash, SPI_WAIT_BLOCK_ERASE_52, erase_timing(flash, blocklen),
+			      100 * 1000, 40 * 1000 * 1000);
 }
 
 /* Block size is usually
@@ -479,41 +638,17 @@ int spi_block_erase_52(struct flashctx *flash, unsigned int addr,
 int spi_block_erase_c4(struct flashctx *flash, unsigned int addr, unsigned int blocklen)
 {
 	int result;
-	struct spi_command cmds[] = {
-	{
-		.writecnt	= JEDEC_WREN_OUTSIZE,
-		.writearr	= (const unsigned char[]){ JEDEC_WREN },
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= JEDEC_BE_C4_OUTSIZE,
-		.writearr	= (const unsigned char[]){
-					JEDEC_BE_C4,
-					(addr >> 16) & 0xff,
-					(addr >> 8) & 0xff,
-					(addr & 0xff)
-				},
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= 0,
-		.writearr	= NULL,
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}};
 
-	result = spi_send_multicommand(flash, cmds);
+	result = spi_write_cmd(flash, JEDEC_BE_C4, 0, addr, NULL, 0);
 	if (result) {
 		msg_cerr("%s failed during command execution at address 0x%x\n", __func__, addr);
 		return result;
 	}
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This usually takes 240-480 s, so wait in 500 ms steps.
+	 * This usually takes 240-480 s.
 	 */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(500 * 1000 * 1000);
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_ready(flash, SPI_WAIT_DIE_ERASE, 240 * 1000 * 1000, 2000 * 1000 * 1000);
 }
 
 /* Block size is usually
@@ -525,42 +660,19 @@ int spi_block_erase_d8(struct flashctx *flash, unsigned int addr,
 		       unsigned int blocklen)
 {
 	int result;
-	struct spi_command cmds[] = {
-	{
-		.writecnt	= JEDEC_WREN_OUTSIZE,
-		.writearr	= (const unsigned char[]){ JEDEC_WREN },
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= JEDEC_BE_D8_OUTSIZE,
-		.writearr	= (const unsigned char[]){
-					JEDEC_BE_D8,
-					(addr >> 16) & 0xff,
-					(addr >> 8) & 0xff,
-					(addr & 0xff)
-				},
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= 0,
-		.writearr	= NULL,
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}};
 
-	result = spi_send_multicommand(flash, cmds);
+	result = spi_write_cmd(flash, JEDEC_BE_D8, JEDEC_BE_DC, addr, NULL, 0);
 	if (result) {
 		msg_cerr("%s failed during command execution at address 0x%x\n",
 			__func__, addr);
 		return result;
 	}
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This usually takes 100-4000 ms, so wait in 100 ms steps.
+	 * This usually takes 100-4000 ms.
 	 */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(100 * 1000);
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_timed(flash, SPI_WAIT_BLOCK_ERASE_D8, erase_timing(flash, blocklen),
+			      100 * 1000, 40 * 1000 * 1000);
 }
 
 /* Block size is usually
@@ -570,83 +682,36 @@ int spi_block_erase_d7(struct flashctx *flash, unsigned int addr,
 		       unsigned int blocklen)
 {
 	int result;
-	struct spi_command cmds[] = {
-	{
-		.writecnt	= JEDEC_WREN_OUTSIZE,
-		.writearr	= (const unsigned char[]){ JEDEC_WREN },
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= JEDEC_BE_D7_OUTSIZE,
-		.writearr	= (const unsigned char[]){
-					JEDEC_BE_D7,
-					(addr >> 16) & 0xff,
-					(addr >> 8) & 0xff,
-					(addr & 0xff)
-				},
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= 0,
-		.writearr	= NULL,
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}};
 
-	result = spi_send_multicommand(flash, cmds);
+	result = spi_write_cmd(flash, JEDEC_BE_D7, 0, addr, NULL, 0);
 	if (result) {
 		msg_cerr("%s failed during command execution at address 0x%x\n",
 			__func__, addr);
 		return result;
 	}
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This usually takes 100-4000 ms, so wait in 100 ms steps.
+	 * This usually takes 100-4000 ms.
 	 */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(100 * 1000);
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_timed(flash, SPI_WAIT_BLOCK_ERASE_D7, erase_timing(flash, blocklen),
+			      100 * 1000, 40 * 1000 * 1000);
 }
 
 /* Page erase (usually 256B blocks) */
 int spi_block_erase_db(struct flashctx *flash, unsigned int addr, unsigned int blocklen)
 {
 	int result;
-	struct spi_command cmds[] = {
-	{
-		.writecnt	= JEDEC_WREN_OUTSIZE,
-		.writearr	= (const unsigned char[]){ JEDEC_WREN },
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= JEDEC_PE_OUTSIZE,
-		.writearr	= (const unsigned char[]){
-					JEDEC_PE,
-					(addr >> 16) & 0xff,
-					(addr >> 8) & 0xff,
-					(addr & 0xff)
-				},
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= 0,
-		.writearr	= NULL,
-		.readcnt	= 0,
-		.readarr	= NULL,
-	} };
 
-	result = spi_send_multicommand(flash, cmds);
+	result = spi_write_cmd(flash, JEDEC_PE, 0, addr, NULL, 0);
 	if (result) {
 		msg_cerr("%s failed during command execution at address 0x%x\n", __func__, addr);
 		return result;
 	}
 
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This takes up to 20 ms usually (on worn out devices up to the 0.5s range), so wait in 1 ms steps. */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(1 * 1000);
+	 * This takes up to 20 ms usually (on worn out devices up to the 0.5s range). */
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_ready(flash, SPI_WAIT_PAGE_ERASE, 10 * 1000, 5 * 1000 * 1000);
 }
 
 /* Sector size is usually 4k, though Macronix eliteflash has 64k */
@@ -654,42 +719,19 @@ int spi_block_erase_20(struct flashctx *flash, unsigned int addr,
 		       unsigned int blocklen)
 {
 	int result;
-	struct spi_command cmds[] = {
-	{
-		.writecnt	= JEDEC_WREN_OUTSIZE,
-		.writearr	= (const unsigned char[]){ JEDEC_WREN },
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= JEDEC_SE_OUTSIZE,
-		.writearr	= (const unsigned char[]){
-					JEDEC_SE,
-					(addr >> 16) & 0xff,
-					(addr >> 8) & 0xff,
-					(addr & 0xff)
-				},
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= 0,
-		.writearr	= NULL,
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}};
 
-	result = spi_send_multicommand(flash, cmds);
+	result = spi_write_cmd(flash, JEDEC_SE, JEDEC_SE_4BA, addr, NULL, 0);
 	if (result) {
 		msg_cerr("%s failed during command execution at address 0x%x\n",
 			__func__, addr);
 		return result;
 	}
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This usually takes 15-800 ms, so wait in 10 ms steps.
+	 * This usually takes 15-800 ms.
 	 */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(10 * 1000);
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_timed(flash, SPI_WAIT_SECTOR_ERASE, erase_timing(flash, blocklen),
+			      40 * 1000, 8 * 1000 * 1000);
 }
 
 int spi_block_erase_50(struct flashctx *flash, unsigned int addr, unsigned int blocklen)
@@ -724,12 +766,10 @@ int spi_block_erase_50(struct flashctx *flash, unsigned int addr, unsigned int b
 		return result;
 	}
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This usually takes 10 ms, so wait in 1 ms steps.
+	 * This usually takes 10 ms.
 	 */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(1 * 1000);
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_ready(flash, SPI_WAIT_PAGE_ERASE, 10 * 1000, 5 * 1000 * 1000);
 }
 
 int spi_block_erase_81(struct flashctx *flash, unsigned int addr, unsigned int blocklen)
@@ -764,12 +804,10 @@ int spi_block_erase_81(struct flashctx *flash, unsigned int addr, unsigned int b
 		return result;
 	}
 	/* Wait until the Write-In-Progress bit is cleared.
-	 * This usually takes 8 ms, so wait in 1 ms steps.
+	 * This usually takes 8 ms.
 	 */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(1 * 1000);
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return spi_wait_ready(flash, SPI_WAIT_PAGE_ERASE, 8 * 1000, 5 * 1000 * 1000);
 }
 
 int spi_block_erase_60(struct flashctx *flash, unsigned int addr,
@@ -844,31 +882,8 @@ int spi_byte_program(struct flashctx *flash, unsigned int addr,
 		     uint8_t databyte)
 {
 	int result;
-	struct spi_command cmds[] = {
-	{
-		.writecnt	= JEDEC_WREN_OUTSIZE,
-		.writearr	= (const unsigned char[]){ JEDEC_WREN },
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= JEDEC_BYTE_PROGRAM_OUTSIZE,
-		.writearr	= (const unsigned char[]){
-					JEDEC_BYTE_PROGRAM,
-					(addr >> 16) & 0xff,
-					(addr >> 8) & 0xff,
-					(addr & 0xff),
-					databyte
-				},
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= 0,
-		.writearr	= NULL,
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}};
 
-	result = spi_send_multicommand(flash, cmds);
+	result = spi_write_cmd(flash, JEDEC_BYTE_PROGRAM, JEDEC_BYTE_PROGRAM_4BA, addr, &databyte, 1);
 	if (result) {
 		msg_cerr("%s failed during command execution at address 0x%x\n",
 			__func__, addr);
@@ -879,43 +894,13 @@ int spi_byte_program(struct flashctx *flash, unsigned int addr,
 int spi_nbyte_program(struct flashctx *flash, unsigned int addr, const uint8_t *bytes, unsigned int len)
 {
 	int result;
-	/* FIXME: Switch to malloc based on len unless that kills speed. */
-	unsigned char cmd[JEDEC_BYTE_PROGRAM_OUTSIZE - 1 + 256] = {
-		JEDEC_BYTE_PROGRAM,
-		(addr >> 16) & 0xff,
-		(addr >> 8) & 0xff,
-		(addr >> 0) & 0xff,
-	};
-	struct spi_command cmds[] = {
-	{
-		.writecnt	= JEDEC_WREN_OUTSIZE,
-		.writearr	= (const unsigned char[]){ JEDEC_WREN },
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= JEDEC_BYTE_PROGRAM_OUTSIZE - 1 + len,
-		.writearr	= cmd,
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}, {
-		.writecnt	= 0,
-		.writearr	= NULL,
-		.readcnt	= 0,
-		.readarr	= NULL,
-	}};
 
 	if (!len) {
 		msg_cerr("%s called for zero-length write\n", __func__);
 		return 1;
 	}
-	if (len > 256) {
-		msg_cerr("%s called for too long a write\n", __func__);
-		return 1;
-	}
 
-	memcpy(&cmd[4], bytes, len);
-
-	result = spi_send_multicommand(flash, cmds);
+	result = spi_write_cmd(flash, JEDEC_BYTE_PROGRAM, JEDEC_BYTE_PROGRAM_4BA, addr, bytes, len);
 	if (result) {
 		msg_cerr("%s failed during command execution at address 0x%x\n",
 			__func__, addr);
@@ -923,18 +908,245 @@ int spi_nbyte_program(struct flashctx *flash, unsigned int addr, const uint8_t *
 	return result;
 }
 
+/* The lowest limit for plain reads found in datasheets. */
+#define SPI_READ_KHZ_DEFAULT	33000
+
+/*
+ * Fast Read costs a dummy byte per command, so it is only used if the master clocks the chip faster than a
+ * plain Read allows. Chips without a known limit are assumed to allow plain reads up to SPI_READ_KHZ_DEFAULT.
+ */
+static bool spi_use_fast_read(const struct flashctx *flash)
+{
+	unsigned int max_khz = flash->chip->timing.max_read_khz;
+
+	if (!(flash->chip->feature_bits & FEATURE_FAST_READ))
+		return false;
+	if (!max_khz)
+		max_khz = SPI_READ_KHZ_DEFAULT;
+	return flash->mst->spi.clock_khz > max_khz;
+}
+
+/*
+ * Returns the fastest SPI clock in kHz the chip can be read at, or 0 if no limit is known. Chips with Fast Read
+ * switch to it above max_read_khz, so only the others are limited.
+ */
+unsigned int spi_max_read_khz(const struct flashctx *flash)
+{
+	if (flash->chip->feature_bits & FEATURE_FAST_READ)
+		return 0;
+	return flash->chip->timing.max_read_khz;
+}
+
+/* Fill cmd with the read command for address and return its length, or -1 on error. */
+int spi_prepare_read(struct flashctx *flash, unsigned char *cmd, unsigned int address)
+{
+	const bool fast = spi_use_fast_read(flash);
+	int addr_len;
+
+	if (fast)
+		addr_len = spi_prepare_address(flash, cmd, JEDEC_FAST_READ, JEDEC_FAST_READ_4BA, address);
+	else
+		addr_len = spi_prepare_address(flash, cmd, JEDEC_READ, JEDEC_READ_4BA, address);
+	if (addr_len < 0)
+		return -1;
+
+	/* Fast Read is followed by a dummy byte. */
+	if (fast)
+		cmd[1 + addr_len] = 0;
+	return 1 + addr_len + (fast ? 1 : 0);
+}
+
 int spi_nbyte_read(struct flashctx *flash, unsigned int address, uint8_t *bytes,
 		   unsigned int len)
 {
-	const unsigned char cmd[JEDEC_READ_OUTSIZE] = {
-		JEDEC_READ,
-		(address >> 16) & 0xff,
-		(address >> 8) & 0xff,
-		(address >> 0) & 0xff,
+	unsigned char cmd[1 + JEDEC_MAX_ADDR_LEN + 1];
+	const int writecnt = spi_prepare_read(flash, cmd, address);
+
+	if (writecnt < 0)
+		return 1;
+	return spi_send_command(flash, writecnt, len, cmd, bytes);
+}
+
+/* Number of reads spi_read_chunked() keeps in flight on masters with a request queue. */
+#define SPI_READ_QUEUE_LEN 4
+
+struct spi_read_slot {
+	unsigned char cmd[1 + JEDEC_MAX_ADDR_LEN + 1];
+	struct spi_command cmds[2];
+	struct spi_async req;
+	bool busy;
+};
+
+/* Queue a read of len bytes at address into bytes, after waiting for the read the slot was used for. */
+static int spi_nbyte_read_submit(struct flashctx *flash, struct spi_read_slot *slot, unsigned int address,
+				 uint8_t *bytes, unsigned int len)
+{
+	int writecnt, ret;
+
+	if (slot->busy) {
+		slot->busy = false;
+		ret = spi_wait(flash, &slot->req);
+		if (ret)
+			return ret;
+	}
+	writecnt = spi_prepare_read(flash, slot->cmd, address);
+	if (writecnt < 0)
+		return 1;
+	slot->cmds[0] = (struct spi_command) {
+		.writecnt	= writecnt,
+		.readcnt	= len,
+		.writearr	= slot->cmd,
+		.readarr	= bytes,
 	};
+	slot->cmds[1] = (struct spi_command) { 0 };
+	slot->req.cmds = slot->cmds;
+	ret = spi_submit(flash, &slot->req);
+	if (!ret)
+		slot->busy = true;
+	return ret;
+}
+
+/* Multi I/O reads, fastest first. The dummy clocks are the usual defaults and include the mode bits. */
+static const struct {
+	unsigned int io_mode;
+	int feature;
+	uint8_t opcode;
+	uint8_t opcode_4ba;
+	unsigned int dummy_clocks;
+	const char *name;
+} spi_multi_io_reads[] = {
+	{ SPI_IO_1_4_4, FEATURE_IO_1_4_4, JEDEC_READ_1_4_4, JEDEC_READ_1_4_4_4BA, 6, "1-4-4" },
+	{ SPI_IO_1_1_4, FEATURE_IO_1_1_4, JEDEC_READ_1_1_4, JEDEC_READ_1_1_4_4BA, 8, "1-1-4" },
+	{ SPI_IO_1_2_2, FEATURE_IO_1_2_2, JEDEC_READ_1_2_2, JEDEC_READ_1_2_2_4BA, 4, "1-2-2" },
+	{ SPI_IO_1_1_2, FEATURE_IO_1_1_2, JEDEC_READ_1_1_2, JEDEC_READ_1_1_2_4BA, 8, "1-1-2" },
+};
+
+/*
+ * Returns the index of the fastest read in spi_multi_io_reads supported by both the chip and the master, or -1
+ * if there is none. Quad modes are only used if the Quad Enable bit is (or can be) set.
+ */
+static int spi_select_multi_io_read(struct flashctx *flash)
+{
+	const unsigned int quad = SPI_IO_1_1_4 | SPI_IO_1_4_4;
+	unsigned int modes = flash->mst->spi.io_modes;
+	int i;
 
-	/* Send Read */
-	return spi_send_command(flash, sizeof(cmd), len, cmd, bytes);
+	if (flash->quad.read_checked)
+		return flash->quad.read;
+	flash->quad.read_checked = true;
+	flash->quad.read = -1;
+	if (!flash->mst->spi.read_multi_io)
+		return -1;
+	for (i = 0; i < ARRAY_SIZE(spi_multi_io_reads); i++)
+		if (!(flash->chip->feature_bits & spi_multi_io_reads[i].feature))
+			modes &= ~spi_multi_io_reads[i].io_mode;
+	if ((modes & quad) && spi_enable_quad_io(flash))
+		modes &= ~quad;
+	for (i = 0; i < ARRAY_SIZE(spi_multi_io_reads); i++) {
+		if (modes & spi_multi_io_reads[i].io_mode) {
+			flash->quad.read = i;
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Read with the multi I/O mode chosen by spi_select_multi_io_read(). Returns SPI_INVALID_OPCODE if there is no
+ * usable mode, so that the caller can fall back to single I/O reads.
+ */
+int spi_read_multi_io(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len)
+{
+	const bool first = !flash->quad.read_checked;
+	const int i = spi_select_multi_io_read(flash);
+	struct spi_multi_io_read cmd;
+	uint8_t opcode[1 + JEDEC_MAX_ADDR_LEN];
+	const struct spi_read_mode *mode;
+	int addr_len, ret;
+
+	if (i < 0)
+		return SPI_INVALID_OPCODE;
+	/* The chip may override the defaults, e.g. with values found in its SFDP table. */
+	mode = &flash->chip->multi_io_reads[ffs(spi_multi_io_reads[i].io_mode) - 1];
+	addr_len = spi_prepare_address(flash, opcode, mode->opcode ? : spi_multi_io_reads[i].opcode,
+				       spi_multi_io_reads[i].opcode_4ba, start);
+	if (addr_len < 0)
+		return 1;
+	if (first)
+		msg_cdbg("Using %s read (0x%02x).\n", spi_multi_io_reads[i].name, opcode[0]);
+	cmd.io_mode = spi_multi_io_reads[i].io_mode;
+	cmd.opcode = opcode[0];
+	cmd.addr = start;
+	cmd.addr_len = addr_len;
+	cmd.dummy_clocks = mode->opcode ? mode->dummy_clocks : spi_multi_io_reads[i].dummy_clocks;
+	ret = flash->mst->spi.read_multi_io(flash, &cmd, buf, len);
+	/* Don't offer the master the same mode again. */
+	if (ret == SPI_INVALID_OPCODE) {
+		msg_cdbg("The master rejected the %s read, using single I/O reads.\n", spi_multi_io_reads[i].name);
+		flash->quad.read = -1;
+	}
+	return ret;
+}
+
+/* Quad page programs in the order of preference. */
+static const struct {
+	unsigned int io_mode;
+	int feature;
+	uint8_t opcode;
+	uint8_t opcode_4ba;
+	const char *name;
+} spi_multi_io_programs[] = {
+	{ SPI_IO_1_4_4, FEATURE_PP_1_4_4, JEDEC_PP_1_4_4, JEDEC_PP_1_4_4_4BA, "1-4-4" },
+	{ SPI_IO_1_1_4, FEATURE_PP_1_1_4, JEDEC_PP_1_1_4, JEDEC_PP_1_1_4_4BA, "1-1-4" },
+};
+
+/*
+ * Returns the index of the quad page program in spi_multi_io_programs supported by both the chip and the
+ * master, or -1 if there is none or the Quad Enable bit can not be set.
+ */
+static int spi_select_multi_io_program(struct flashctx *flash)
+{
+	int i;
+
+	if (flash->quad.program_checked)
+		return flash->quad.program;
+	flash->quad.program_checked = true;
+	flash->quad.program = -1;
+	if (!flash->mst->spi.write_multi_io)
+		return -1;
+	for (i = 0; i < ARRAY_SIZE(spi_multi_io_programs); i++) {
+		if (!(flash->mst->spi.io_modes & spi_multi_io_programs[i].io_mode) ||
+		    !(flash->chip->feature_bits & spi_multi_io_programs[i].feature))
+			continue;
+		if (spi_enable_quad_io(flash))
+			return -1;
+		msg_cdbg("Using %s page program (0x%02x).\n", spi_multi_io_programs[i].name,
+			 spi_multi_io_programs[i].opcode);
+		flash->quad.program = i;
+		return i;
+	}
+	return -1;
+}
+
+static int spi_nbyte_program_multi_io(struct flashctx *flash, int mode, unsigned int addr, const uint8_t *bytes,
+				      unsigned int len)
+{
+	static const unsigned char cmd_wren[JEDEC_WREN_OUTSIZE] = { JEDEC_WREN };
+	struct spi_multi_io_write cmd;
+	uint8_t opcode[1 + JEDEC_MAX_ADDR_LEN];
+	int addr_len;
+
+	addr_len = spi_prepare_address(flash, opcode, spi_multi_io_programs[mode].opcode,
+				       spi_multi_io_programs[mode].opcode_4ba, addr);
+	if (addr_len < 0)
+		return 1;
+	if (spi_send_command(flash, sizeof(cmd_wren), 0, cmd_wren, NULL))
+		return 1;
+	cmd.io_mode = spi_multi_io_programs[mode].io_mode;
+	cmd.opcode = opcode[0];
+	cmd.addr = addr;
+	cmd.addr_len = addr_len;
+	return flash->mst->spi.write_multi_io(flash, &cmd, bytes, len);
 }
 
 /*
@@ -945,9 +1157,16 @@ int spi_nbyte_read(struct flashctx *flash, unsigned int address, uint8_t *bytes,
 int spi_read_chunked(struct flashctx *flash, uint8_t *buf, unsigned int start,
 		     unsigned int len, unsigned int chunksize)
 {
-	int rc = 0;
+	int rc = 0, ret;
 	unsigned int i, j, starthere, lenhere, toread;
 	unsigned int page_size = flash->chip->page_size;
+	/* Masters with a request queue get the next reads while the earlier ones are still on the bus. */
+	const bool queued = flash->mst->spi.submit != NULL;
+	struct spi_read_slot slots[SPI_READ_QUEUE_LEN];
+	unsigned int slot = 0;
+
+	if (queued)
+		memset(slots, 0, sizeof(slots));
 
 	/* Warning: This loop has a very unusual condition and body.
 	 * The loop needs to go through each page with at least one affected
@@ -966,7 +1185,13 @@ int spi_read_chunked(struct flashctx *flash, uint8_t *buf, unsigned int start,
 		lenhere = min(start + len, (i + 1) * page_size) - starthere;
 		for (j = 0; j < lenhere; j += chunksize) {
 			toread = min(chunksize, lenhere - j);
-			rc = spi_nbyte_read(flash, starthere + j, buf + starthere - start + j, toread);
+			if (queued) {
+				rc = spi_nbyte_read_submit(flash, &slots[slot], starthere + j,
+							   buf + starthere - start + j, toread);
+				slot = (slot + 1) % SPI_READ_QUEUE_LEN;
+			} else {
+				rc = spi_nbyte_read(flash, starthere + j, buf + starthere - start + j, toread);
+			}
 			if (rc)
 				break;
 		}
@@ -974,6 +1199,15 @@ int spi_read_chunked(struct flashctx *flash, uint8_t *buf, unsigned int start,
 			break;
 	}
 
+	/* The commands of the reads still in flight live in slots. */
+	for (i = 0; queued && i < SPI_READ_QUEUE_LEN; i++) {
+		if (!slots[i].busy)
+			continue;
+		ret = spi_wait(flash, &slots[i].req);
+		if (!rc)
+			rc = ret;
+	}
+
 	return rc;
 }
 
@@ -993,6 +1227,14 @@ int spi_write_chunked(struct flashctx *flash, const uint8_t *buf, unsigned int s
 	 * we're OK for now.
 	 */
 	unsigned int page_size = flash->chip->page_size;
+	/* Quad page programs send a whole page at once. */
+	int mode = spi_select_multi_io_program(flash);
+	const struct spi_write_wait wait = {
+		.op		= SPI_WAIT_PAGE_PROGRAM,
+		.timing		= &flash->chip->timing.page_program,
+		.typ_us		= SPI_PAGE_PROGRAM_TYP,
+		.timeout_us	= SPI_PROGRAM_TIMEOUT,
+	};
 
 	/* Warning: This loop has a very unusual condition and body.
 	 * The loop needs to go through each page with at least one affected
@@ -1009,13 +1251,27 @@ int spi_write_chunked(struct flashctx *flash, const uint8_t *buf, unsigned int s
 		starthere = max(start, i * page_size);
 		/* Length of bytes in the range in this page. */
 		lenhere = min(start + len, (i + 1) * page_size) - starthere;
-		for (j = 0; j < lenhere; j += chunksize) {
-			towrite = min(chunksize, lenhere - j);
-			rc = spi_nbyte_program(flash, starthere + j, buf + starthere - start + j, towrite);
+		for (j = 0; j < lenhere; j += towrite) {
+			if (mode >= 0) {
+				towrite = lenhere - j;
+				rc = spi_nbyte_program_multi_io(flash, mode, starthere + j,
+								buf + starthere - start + j, towrite);
+				if (rc == SPI_INVALID_OPCODE) {
+					msg_cdbg("Quad page program refused, falling back to 0x02.\n");
+					mode = -1;
+				} else if (!rc) {
+					rc = spi_wait_timed(flash, wait.op, wait.timing, wait.typ_us,
+							    wait.timeout_us);
+				}
+			}
+			if (mode < 0) {
+				towrite = min(chunksize, lenhere - j);
+				/* WREN, the page program and the status polling as one operation. */
+				rc = spi_write_cmd_wait(flash, JEDEC_BYTE_PROGRAM, JEDEC_BYTE_PROGRAM_4BA,
+							starthere + j, buf + starthere - start + j, towrite, &wait);
+			}
 			if (rc)
 				break;
-			while (spi_read_status_register(flash) & SPI_SR_WIP)
-				programmer_delay(10);
 		}
 		if (rc)
 			break;
@@ -1024,6 +1280,9 @@ int spi_write_chunked(struct flashctx *flash, const uint8_t *buf, unsigned int s
 	return rc;
 }
 
+/* Byte programs sent without reading the status register in between. */
+#define SPI_BYTE_PROGRAM_BATCH	64
+
 /*
  * Program chip using byte programming. (SLOW!)
  * This is for chips which can only handle one byte writes
@@ -1033,27 +1292,77 @@ int spi_write_chunked(struct flashctx *flash, const uint8_t *buf, unsigned int s
 /* real chunksize is 1, logical chunksize is 1 */
 int spi_chip_write_1(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
 {
-	unsigned int i;
-	int result = 0;
+	static const unsigned char cmd_wren[JEDEC_WREN_OUTSIZE] = { JEDEC_WREN };
+	const struct op_timing *t = &flash->chip->timing.byte_program;
+	const struct spi_write_wait wait = {
+		.op		= SPI_WAIT_BYTE_PROGRAM,
+		.timing		= t,
+		.typ_us		= SPI_BYTE_PROGRAM_TYP,
+		.timeout_us	= SPI_PROGRAM_TIMEOUT,
+	};
+	unsigned char cmd[SPI_BYTE_PROGRAM_BATCH][1 + JEDEC_MAX_ADDR_LEN + 1];
+	/* WREN and the byte program for every byte plus the terminator. */
+	struct spi_command cmds[2 * SPI_BYTE_PROGRAM_BATCH + 1];
+	unsigned int i, n;
+	int addr_len;
+
+	/* Without a known maximum duration each byte is polled for. Masters with multicommand_poll still send
+	 * WREN, the byte program and the polls in one transaction.
+	 */
+	if (!t->max) {
+		for (i = start; i < start + len; i++) {
+			if (spi_write_cmd_wait(flash, JEDEC_BYTE_PROGRAM, JEDEC_BYTE_PROGRAM_4BA, i, &buf[i - start],
+					       1, &wait)) {
+				msg_cerr("%s failed at address 0x%x\n", __func__, i);
+				return 1;
+			}
+		}
+		return 0;
+	}
 
-	for (i = start; i < start + len; i++) {
-		result = spi_byte_program(flash, i, buf[i - start]);
-		if (result)
+	/* Otherwise the bytes are sent in batches with a fixed delay of twice the maximum duration after each
+	 * one, and only the last byte of a batch is polled for.
+	 */
+	for (i = start; i < start + len; ) {
+		for (n = 0; n < SPI_BYTE_PROGRAM_BATCH && i < start + len; n++, i++) {
+			addr_len = spi_prepare_address(flash, cmd[n], JEDEC_BYTE_PROGRAM, JEDEC_BYTE_PROGRAM_4BA, i);
+			if (addr_len < 0)
+				return 1;
+			cmd[n][1 + addr_len] = buf[i - start];
+			cmds[2 * n] = (struct spi_command){
+				.writecnt	= sizeof(cmd_wren),
+				.writearr	= cmd_wren,
+			};
+			cmds[2 * n + 1] = (struct spi_command){
+				.writecnt	= 1 + addr_len + 1,
+				.writearr	= cmd[n],
+				.delay_us	= 2 * t->max,
+			};
+		}
+		cmds[2 * n - 1].delay_us = 0;
+		cmds[2 * n] = (struct spi_command){ .writecnt = 0, .readcnt = 0 };
+		if (spi_send_multicommand_timed(flash, cmds, wait.op, wait.timing, wait.typ_us, wait.timeout_us)) {
+			msg_cerr("%s failed in the batch ending at address 0x%x\n", __func__, i - 1);
 			return 1;
-		while (spi_read_status_register(flash) & SPI_SR_WIP)
-			programmer_delay(10);
+		}
 	}
 
 	return 0;
 }
 
+/* AAI words sent without reading the status register in between. */
+#define SPI_AAI_BATCH_WORDS	128
+
 int default_spi_write_aai(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
 {
 	uint32_t pos = start;
 	int result;
-	unsigned char cmd[JEDEC_AAI_WORD_PROGRAM_CONT_OUTSIZE] = {
-		JEDEC_AAI_WORD_PROGRAM,
-	};
+	const unsigned int word_delay = 2 * (flash->chip->timing.byte_program.max ?
+					     flash->chip->timing.byte_program.max : SPI_BYTE_PROGRAM_MAX);
+	unsigned char words[SPI_AAI_BATCH_WORDS][JEDEC_AAI_WORD_PROGRAM_CONT_OUTSIZE];
+	/* WREN, the start command, the words and the terminator. */
+	struct spi_command batch[2 + SPI_AAI_BATCH_WORDS + 1];
+	unsigned int n, w;
 	struct spi_command cmds[] = {
 	{
 		.writecnt	= JEDEC_WREN_OUTSIZE,
@@ -1125,29 +1434,38 @@ int default_spi_write_aai(struct flashctx *flash, const uint8_t *buf, unsigned i
 	}
 
 
-	result = spi_send_multicommand(flash, cmds);
-	if (result != 0) {
-		msg_cerr("%s failed during start command execution: %d\n", __func__, result);
-		goto bailout;
-	}
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
-		programmer_delay(10);
-
-	/* We already wrote 2 bytes in the multicommand step. */
+	/* The start command and the following words are streamed in batches. Each word gets a fixed delay of
+	 * twice the maximum byte program time and the status register is only polled at the end of a batch.
+	 */
+	batch[0] = cmds[0];
+	batch[1] = cmds[1];
+	batch[1].delay_us = word_delay;
+	n = 2;
+	/* We already wrote 2 bytes in the start command. */
 	pos += 2;
-
-	/* Are there at least two more bytes to write? */
-	while (pos < start + len - 1) {
-		cmd[1] = buf[pos++ - start];
-		cmd[2] = buf[pos++ - start];
-		result = spi_send_command(flash, JEDEC_AAI_WORD_PROGRAM_CONT_OUTSIZE, 0, cmd, NULL);
+	do {
+		/* Are there at least two more bytes to write? */
+		for (w = 0; w < SPI_AAI_BATCH_WORDS && pos < start + len - 1; w++) {
+			words[w][0] = JEDEC_AAI_WORD_PROGRAM;
+			words[w][1] = buf[pos++ - start];
+			words[w][2] = buf[pos++ - start];
+			batch[n++] = (struct spi_command){
+				.writecnt	= JEDEC_AAI_WORD_PROGRAM_CONT_OUTSIZE,
+				.writearr	= words[w],
+				.delay_us	= word_delay,
+			};
+		}
+		batch[n - 1].delay_us = 0;
+		batch[n] = (struct spi_command){ .writecnt = 0, .readcnt = 0 };
+		result = spi_send_multicommand_timed(flash, batch, SPI_WAIT_BYTE_PROGRAM,
+						     &flash->chip->timing.byte_program, SPI_BYTE_PROGRAM_TYP,
+						     SPI_PROGRAM_TIMEOUT);
 		if (result != 0) {
-			msg_cerr("%s failed during followup AAI command execution: %d\n", __func__, result);
+			msg_cerr("%s failed during AAI command execution: %d\n", __func__, result);
 			goto bailout;
 		}
-		while (spi_read_status_register(flash) & SPI_SR_WIP)
-			programmer_delay(10);
-	}
+		n = 0;
+	} while (pos < start + len - 1);
 
 	/* Use WRDI to exit AAI mode. This needs to be done before issuing any other non-AAI command. */
 	result = spi_write_disable(flash);
@@ -21,8 +21,10 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
  */
 
+#include <string.h>
 #include "flash.h"
 #include "chipdrivers.h"
+#include "programmer.h"
 #include "spi.h"
 
 /* === Generic functions === */
@@ -40,10 +42,11 @@ int spi_write_status_enable(struct flashctx *flash)
 	return result;
 }
 
-static int spi_write_status_register_flag(struct flashctx *flash, int status, const unsigned char enable_opcode)
+/* Write @len (1 or 2) status register bytes with a single WRSR. */
+static int spi_write_status_register_flag(struct flashctx *flash, const unsigned char *status, unsigned int len,
+					  const unsigned char enable_opcode)
 {
 	int result;
-	int i = 0;
 	/*
 	 * WRSR requires either EWSR or WREN depending on chip type.
 	 * The code below relies on the fact hat EWSR and WREN have the same
@@ -56,8 +59,8 @@ static int spi_write_status_register_flag(struct flashctx *flash, int status, co
 		.readcnt	= 0,
 		.readarr	= NULL,
 	}, {
-		.writecnt	= JEDEC_WRSR_OUTSIZE,
-		.writearr	= (const unsigned char[]){ JEDEC_WRSR, (unsigned char) status },
+		.writecnt	= JEDEC_WRSR_OUTSIZE + len - 1,
+		.writearr	= (const unsigned char[]){ JEDEC_WRSR, status[0], len > 1 ? status[1] : 0 },
 		.readcnt	= 0,
 		.readarr	= NULL,
 	}, {
@@ -78,20 +81,15 @@ static int spi_write_status_register_flag(struct flashctx *flash, int status, co
 	/* WRSR performs a self-timed erase before the changes take effect.
 	 * This may take 50-85 ms in most cases, and some chips apparently
 	 * allow running RDSR only once. Therefore pick an initial delay of
-	 * 100 ms, then wait in 10 ms steps until a total of 5 s have elapsed.
+	 * 100 ms, then poll until a total of 5 s have elapsed.
 	 */
-	programmer_delay(100 * 1000);
-	while (spi_read_status_register(flash) & SPI_SR_WIP) {
-		if (++i > 490) {
-			msg_cerr("Error: WIP bit after WRSR never cleared\n");
-			return TIMEOUT_ERROR;
-		}
-		programmer_delay(10 * 1000);
-	}
-	return 0;
+	result = spi_wait_ready(flash, SPI_WAIT_WRSR, 100 * 1000, 5 * 1000 * 1000);
+	if (result)
+		msg_cerr("Error: WIP bit after WRSR never cleared\n");
+	return result;
 }
 
-int spi_write_status_register(struct flashctx *flash, int status)
+static int spi_write_status_registers(struct flashctx *flash, const unsigned char *status, unsigned int len)
 {
 	int feature_bits = flash->chip->feature_bits;
 	int ret = 1;
@@ -102,12 +100,19 @@ int spi_write_status_register(struct flashctx *flash, int status)
 		feature_bits |= FEATURE_WRSR_EWSR;
 	}
 	if (feature_bits & FEATURE_WRSR_WREN)
-		ret = spi_write_status_register_flag(flash, status, JEDEC_WREN);
+		ret = spi_write_status_register_flag(flash, status, len, JEDEC_WREN);
 	if (ret && (feature_bits & FEATURE_WRSR_EWSR))
-		ret = spi_write_status_register_flag(flash, status, JEDEC_EWSR);
+		ret = spi_write_status_register_flag(flash, status, len, JEDEC_EWSR);
 	return ret;
 }
 
+int spi_write_status_register(struct flashctx *flash, int status)
+{
+	const unsigned char sr = status;
+
+	return spi_write_status_registers(flash, &sr, 1);
+}
+
 uint8_t spi_read_status_register(struct flashctx *flash)
 {
 	static const unsigned char cmd[JEDEC_RDSR_OUTSIZE] = { JEDEC_RDSR };
@@ -123,6 +128,244 @@ uint8_t spi_read_status_register(struct flashctx *flash)
 	return readarr[0];
 }
 
+/* Like spi_read_status_register() but reports failures. */
+static int spi_read_status_register_checked(struct flashctx *flash, uint8_t *status)
+{
+	static const unsigned char cmd[JEDEC_RDSR_OUTSIZE] = { JEDEC_RDSR };
+	unsigned char readarr[2]; /* JEDEC_RDSR_INSIZE=1 but wbsio needs 2 */
+	int ret;
+
+	ret = spi_send_command(flash, sizeof(cmd), sizeof(readarr), cmd, readarr);
+	if (ret) {
+		msg_cerr("RDSR failed!\n");
+		return ret;
+	}
+	*status = readarr[0];
+	return 0;
+}
+
+static int spi_read_status_register_2(struct flashctx *flash, uint8_t *status)
+{
+	static const unsigned char cmd[JEDEC_RDSR2_OUTSIZE] = { JEDEC_RDSR2 };
+	unsigned char readarr[JEDEC_RDSR2_INSIZE];
+	int ret;
+
+	ret = spi_send_command(flash, sizeof(cmd), sizeof(readarr), cmd, readarr);
+	if (ret) {
+		msg_cerr("RDSR2 failed!\n");
+		return ret;
+	}
+	*status = readarr[0];
+	return 0;
+}
+
+/*
+ * Set the Quad Enable bit needed by the quad I/O modes unless it is set already. The bit is non-volatile on most
+ * chips and disables the /WP and /HOLD functions of the shared pins, hence it is only set if the user allowed it,
+ * and spi_restore_quad_io() writes the old status registers back at the end of the session.
+ */
+static int spi_set_quad_enable(struct flashctx *flash)
+{
+	const int feature_bits = flash->chip->feature_bits;
+	unsigned char sr[2] = { 0 };
+	unsigned int len;
+	uint8_t qe;
+
+	if (feature_bits & FEATURE_QE_NONE) {
+		return 0;
+	} else if (feature_bits & FEATURE_QE_SR1_BIT6) {
+		len = 1;
+		qe = 1 << 6;
+	} else if (feature_bits & FEATURE_QE_SR2_BIT1) {
+		len = 2;
+		qe = 1 << 1;
+	} else {
+		msg_cdbg("Unknown location of the Quad Enable bit.\n");
+		return 1;
+	}
+	if (spi_read_status_register_checked(flash, &sr[0]) ||
+	    (len > 1 && spi_read_status_register_2(flash, &sr[1])))
+		return 1;
+	if (sr[len - 1] & qe)
+		return 0;
+	/* The bit is non-volatile and disables /WP and /HOLD, hence it is only touched if asked to. */
+	if (!flash->flags.quad_enable) {
+		msg_cdbg("The Quad Enable bit is not set, not using quad I/O.\n");
+		return 1;
+	}
+
+	msg_cdbg("Setting the Quad Enable bit... ");
+	sr[0] &= ~(SPI_SR_WEL | SPI_SR_WIP);
+	memcpy(flash->quad.sr, sr, len);
+	flash->quad.sr_len = len;
+	sr[len - 1] |= qe;
+	if (spi_write_status_registers(flash, sr, len)) {
+		msg_cdbg("failed.\n");
+		return 1;
+	}
+	flash->quad.restore = true;
+	if (spi_read_status_register_checked(flash, &sr[0]) ||
+	    (len > 1 && spi_read_status_register_2(flash, &sr[1])) || !(sr[len - 1] & qe)) {
+		msg_cdbg("failed.\n");
+		return 1;
+	}
+	msg_cdbg("done.\n");
+	return 0;
+}
+
+/* Returns 0 if quad I/O commands can be used. The result is cached until spi_restore_quad_io(). */
+int spi_enable_quad_io(struct flashctx *flash)
+{
+	if (!flash->quad.checked) {
+		flash->quad.usable = !spi_set_quad_enable(flash);
+		flash->quad.checked = true;
+	}
+	return flash->quad.usable ? 0 : 1;
+}
+
+/* Restore the status registers if spi_enable_quad_io() changed them. */
+int spi_restore_quad_io(struct flashctx *flash)
+{
+	flash->quad.checked = false;
+	flash->quad.read_checked = false;
+	flash->quad.program_checked = false;
+	if (!flash->quad.restore)
+		return 0;
+	flash->quad.restore = false;
+	if (spi_write_status_registers(flash, flash->quad.sr, flash->quad.sr_len)) {
+		msg_cerr("Restoring the Quad Enable bit failed.\n");
+		return 1;
+	}
+	msg_cdbg("Restored the Quad Enable bit.\n");
+	return 0;
+}
+
+/*
+ * Shared wait-for-ready logic for all self-timed operations (program, erase, WRSR).
+ *
+ * The chip is left alone for the expected duration of the operation first and then polled with exponentially
+ * growing intervals. For operations that may be polled early, the initial delay adapts to the completion times
+ * we actually observe: If the chip was already done when we first looked, we slept too long and shorten the
+ * delay for the next operation of that kind, otherwise we move it towards the measured completion time.
+ * Elapsed times are the sum of the delays we asked for, the duration of the RDSR commands is not included.
+ */
+static struct spi_wait_state {
+	const char *name;
+	bool adaptive;		/* Polling before the expected duration has elapsed is allowed. */
+	bool initialized;
+	unsigned int delay;	/* Current initial delay in us. */
+	unsigned int count;
+	unsigned long long total; /* Sum of measured completion times in us. */
+	unsigned int max;
+} spi_wait_states[SPI_WAIT_OP_COUNT] = {
+	[SPI_WAIT_BYTE_PROGRAM]	= { .name = "byte program",	.adaptive = true },
+	[SPI_WAIT_PAGE_PROGRAM]	= { .name = "page program",	.adaptive = true },
+	[SPI_WAIT_PAGE_ERASE]	= { .name = "page erase",	.adaptive = true },
+	[SPI_WAIT_SECTOR_ERASE]	= { .name = "sector erase",	.adaptive = true },
+	/* Block sizes differ between the opcodes, so each one learns on its own. */
+	[SPI_WAIT_BLOCK_ERASE_52] = { .name = "block erase (0x52)", .adaptive = true },
+	[SPI_WAIT_BLOCK_ERASE_D7] = { .name = "block erase (0xd7)", .adaptive = true },
+	[SPI_WAIT_BLOCK_ERASE_D8] = { .name = "block erase (0xd8)", .adaptive = true },
+	[SPI_WAIT_CHIP_ERASE]	= { .name = "chip erase",	.adaptive = true },
+	[SPI_WAIT_DIE_ERASE]	= { .name = "die erase",	.adaptive = true },
+	/* Some chips apparently allow running RDSR only once after WRSR, hence the full delay is always used. */
+	[SPI_WAIT_WRSR]		= { .name = "status register write", .adaptive = false },
+	[SPI_WAIT_IDLE]		= { .name = "idle check",	.adaptive = false },
+};
+
+/* Poll intervals never exceed 1 s. */
+#define SPI_WAIT_MAX_STEP (1000 * 1000)
+/* Status register reads appended to the commands by masters with a multicommand_poll function. */
+#define SPI_WAIT_FUSED_POLLS 4
+
+/*
+ * Send @cmds (if not NULL) and wait until the write-in-progress bit of the status register is cleared.
+ * If the master supports it, the commands and the first status register reads are a single bus transaction.
+ * @op		kind of the operation, used for logging and for adapting the initial delay
+ * @typ_us	typical duration of the operation according to the datasheet, 0 if nothing should be running
+ *		anymore (polling starts immediately and backs off to 1 ms steps)
+ * @timeout_us	give up after this time has passed
+ * @return	0 on success, TIMEOUT_ERROR or the error of a failed command or status register read otherwise
+ */
+int spi_send_multicommand_wait(struct flashctx *flash, struct spi_command *cmds, enum spi_wait_op op,
+			       unsigned int typ_us, unsigned int timeout_us)
+{
+	struct spi_wait_state *state = &spi_wait_states[op];
+	unsigned int delay, step, cap, elapsed, polls = 0, fused = 0;
+	uint8_t fused_status[SPI_WAIT_FUSED_POLLS];
+	uint8_t status;
+	int ret;
+
+	if (!state->adaptive || !state->initialized) {
+		state->delay = typ_us;
+		state->initialized = true;
+	}
+	delay = state->delay;
+	cap = typ_us ? min(max(typ_us / 4, 1), SPI_WAIT_MAX_STEP) : 1000;
+	step = min(max(delay / 8, 1), cap);
+
+	if (cmds && flash->mst->spi.multicommand_poll) {
+		ret = flash->mst->spi.multicommand_poll(flash, cmds, delay, step, SPI_WAIT_FUSED_POLLS,
+							fused_status);
+		if (!ret)
+			fused = SPI_WAIT_FUSED_POLLS;
+		else if (ret != SPI_INVALID_OPCODE)
+			return ret;
+	}
+	if (!fused) {
+		if (cmds) {
+			ret = spi_send_multicommand(flash, cmds);
+			if (ret)
+				return ret;
+		}
+		if (delay)
+			programmer_delay(delay);
+	}
+	elapsed = delay;
+	while (1) {
+		if (polls < fused) {
+			status = fused_status[polls];
+		} else {
+			ret = spi_read_status_register_checked(flash, &status);
+			if (ret)
+				return ret;
+		}
+		polls++;
+		if (!(status & SPI_SR_WIP))
+			break;
+		if (elapsed >= timeout_us) {
+			msg_cerr("%s: %s did not finish within %u ms\n", __func__, state->name,
+				 timeout_us / 1000);
+			return TIMEOUT_ERROR;
+		}
+		elapsed += step;
+		/* The master already waited between its status register reads. */
+		if (polls < fused)
+			continue;
+		programmer_delay(step);
+		step = min(step * 2, cap);
+	}
+
+	if (state->adaptive) {
+		if (polls == 1)
+			state->delay = delay - delay / 4;
+		else
+			state->delay = (delay + elapsed) / 2;
+	}
+	state->count++;
+	state->total += elapsed;
+	state->max = max(state->max, elapsed);
+	msg_cspew("%s: %s done after %u us (%u polls, average %llu us, max %u us)\n", __func__, state->name,
+		  elapsed, polls, state->total / state->count, state->max);
+	return 0;
+}
+
+/* Wait until the write-in-progress bit of the status register is cleared, see spi_send_multicommand_wait(). */
+int spi_wait_ready(struct flashctx *flash, enum spi_wait_op op, unsigned int typ_us, unsigned int timeout_us)
+{
+	return spi_send_multicommand_wait(flash, NULL, op, typ_us, timeout_us);
+}
+
 /* A generic block protection disable.
  * Tests if a protection is enabled with the block protection mask (bp_mask) and returns success otherwise.
  * Tests if the register bits are locked with the lock_mask (lock_mask).
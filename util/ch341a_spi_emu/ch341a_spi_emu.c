@@ -0,0 +1,645 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Mocked libusb layer behind ch341a_spi.c, with a simulated CH341A and a SPI flash chip attached to it.
+ *
+ * OUT transfers are cut into 32 byte USB packets like the host controller does, and each packet is run by the
+ * simulated CH341A. The reply to a SPI stream packet is a short packet of its own and completes the oldest queued
+ * IN transfer. The device holds only one reply, so OUT packets stall while nobody picks it up. When nothing can
+ * move anymore, all pending transfers time out like they would on real hardware.
+ *
+ * The emulated chip derives time from the device's UIO and SPI stream operations and the host delays, and flags
+ * any command other than RDSR while a program operation is running.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libusb.h>
+
+/* Reroute the libusb calls of the driver to the mock. */
+#define libusb_init			emu_libusb_init
+#define libusb_exit			emu_libusb_exit
+#define libusb_set_debug		emu_libusb_set_debug
+#define libusb_open_device_with_vid_pid	emu_libusb_open_device_with_vid_pid
+#define libusb_close			emu_libusb_close
+#define libusb_detach_kernel_driver	emu_libusb_detach_kernel_driver
+#define libusb_claim_interface		emu_libusb_claim_interface
+#define libusb_release_interface	emu_libusb_release_interface
+#define libusb_get_device		emu_libusb_get_device
+#define libusb_get_device_descriptor	emu_libusb_get_device_descriptor
+#define libusb_alloc_transfer		emu_libusb_alloc_transfer
+#define libusb_free_transfer		emu_libusb_free_transfer
+#define libusb_submit_transfer		emu_libusb_submit_transfer
+#define libusb_cancel_transfer		emu_libusb_cancel_transfer
+#define libusb_handle_events_timeout	emu_libusb_handle_events_timeout
+#define libusb_error_name		emu_libusb_error_name
+
+static int emu_libusb_init(struct libusb_context **ctx);
+static void emu_libusb_exit(struct libusb_context *ctx);
+static void emu_libusb_set_debug(struct libusb_context *ctx, int level);
+static struct libusb_device_handle *emu_libusb_open_device_with_vid_pid(struct libusb_context *ctx, uint16_t vid,
+									 uint16_t pid);
+static void emu_libusb_close(struct libusb_device_handle *dev_handle);
+static int emu_libusb_detach_kernel_driver(struct libusb_device_handle *dev_handle, int interface);
+static int emu_libusb_claim_interface(struct libusb_device_handle *dev_handle, int interface);
+static int emu_libusb_release_interface(struct libusb_device_handle *dev_handle, int interface);
+static struct libusb_device *emu_libusb_get_device(struct libusb_device_handle *dev_handle);
+static int emu_libusb_get_device_descriptor(struct libusb_device *dev, struct libusb_device_descriptor *desc);
+static struct libusb_transfer *emu_libusb_alloc_transfer(int iso_packets);
+static void emu_libusb_free_transfer(struct libusb_transfer *transfer);
+static int emu_libusb_submit_transfer(struct libusb_transfer *transfer);
+static int emu_libusb_cancel_transfer(struct libusb_transfer *transfer);
+static int emu_libusb_handle_events_timeout(struct libusb_context *ctx, struct timeval *tv);
+static const char *emu_libusb_error_name(int code);
+
+#include "ch341a_spi.c"
+
+#define FLASH_SIZE	(1024 * 1024)
+#define PAGE_SIZE	256
+#define PP_US		800
+/* Duration of a UIO stream output and of a SPI stream byte in ns. */
+#define UIO_NS		750
+#define SPI_BYTE_NS	5300
+/* Transfers that may be queued at once */
+#define MAX_QUEUED	(USB_IN_TRANSFERS + 1)
+/* Read data carried by a SPI stream packet and by a full OUT transfer of them */
+#define READ_PER_PACKET	(CH341_PACKET_LENGTH - 1)
+#define READ_PER_OUT	(READ_PER_PACKET * CH341_MAX_PACKETS)
+
+static struct {
+	/* USB state */
+	struct libusb_transfer *queue[MAX_QUEUED];
+	unsigned int queued;
+	unsigned int out_pos;
+	uint8_t reply[CH341_PACKET_LENGTH];
+	unsigned int reply_len;
+	/* Statistics */
+	unsigned int out_transfers, in_transfers, round_trips, errors;
+	/* CH341A state */
+	int cs;
+	uint64_t ns;
+	/* SPI flash state */
+	uint8_t mem[FLASH_SIZE];
+	uint8_t page[PAGE_SIZE];
+	unsigned int pos, opcode, addr, page_len;
+	int wel;
+	uint64_t busy_until;
+} emu;
+
+static uint8_t shadow[FLASH_SIZE];
+
+int print(enum msglevel level, const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	if (level > MSG_WARN)
+		return 0;
+	va_start(ap, fmt);
+	ret = vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	return ret;
+}
+
+static void emu_error(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fprintf(stderr, "EMULATOR: ");
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	emu.errors++;
+}
+
+/* Stubs for the flashrom core functions used by the driver. */
+void internal_delay(unsigned int usecs)
+{
+	emu.ns += usecs * 1000ULL;
+}
+
+static const struct spi_master *registered;
+
+int register_spi_master(const struct spi_master *mst)
+{
+	registered = mst;
+	return 0;
+}
+
+int register_shutdown(int (*function) (void *data), void *data)
+{
+	return 0;
+}
+
+int spi_prepare_read(struct flashctx *flash, uint8_t *cmd, unsigned int addr)
+{
+	cmd[0] = JEDEC_READ;
+	cmd[1] = (addr >> 16) & 0xff;
+	cmd[2] = (addr >> 8) & 0xff;
+	cmd[3] = addr & 0xff;
+	return 4;
+}
+
+int default_spi_send_multicommand(struct flashctx *flash, struct spi_command *cmds)
+{
+	int ret = 0;
+
+	for (; !ret && (cmds->writecnt || cmds->readcnt); cmds++) {
+		ret = registered->command(flash, cmds->writecnt, cmds->readcnt, cmds->writearr, cmds->readarr);
+		if (!ret && cmds->delay_us)
+			ch341a_spi_delay(cmds->delay_us);
+	}
+	return ret;
+}
+
+int default_spi_write_256(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return 1;
+}
+
+int default_spi_write_aai(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return 1;
+}
+
+/* The SPI flash chip */
+static int flash_busy(void)
+{
+	return emu.ns < emu.busy_until;
+}
+
+static void flash_select(void)
+{
+	emu.pos = 0;
+	emu.page_len = 0;
+}
+
+static void flash_deselect(void)
+{
+	unsigned int i, base;
+
+	if (emu.pos == 0 || flash_busy())
+		return;
+	switch (emu.opcode) {
+	case JEDEC_WREN:
+		emu.wel = 1;
+		break;
+	case JEDEC_WRDI:
+		emu.wel = 0;
+		break;
+	case JEDEC_BYTE_PROGRAM:
+		if (!emu.wel || emu.pos < 4)
+			break;
+		base = emu.addr & ~(PAGE_SIZE - 1);
+		for (i = 0; i < emu.page_len; i++)
+			emu.mem[base + (emu.addr + i) % PAGE_SIZE] &= emu.page[i];
+		emu.busy_until = emu.ns + PP_US * 1000ULL;
+		emu.wel = 0;
+		break;
+	}
+}
+
+static uint8_t flash_byte(uint8_t in)
+{
+	uint8_t out = 0xff;
+
+	if (emu.pos == 0) {
+		emu.opcode = in;
+		emu.addr = 0;
+		if (flash_busy() && in != JEDEC_RDSR)
+			emu_error("opcode 0x%02x sent while the chip is busy.\n", in);
+	} else if (flash_busy()) {
+		if (emu.opcode == JEDEC_RDSR)
+			out = SPI_SR_WIP | (emu.wel ? SPI_SR_WEL : 0);
+	} else {
+		switch (emu.opcode) {
+		case JEDEC_RDID: {
+			static const uint8_t id[] = { 0xef, 0x40, 0x14 };
+			out = emu.pos <= sizeof(id) ? id[emu.pos - 1] : 0xff;
+			break;
+		}
+		case JEDEC_RDSR:
+			out = emu.wel ? SPI_SR_WEL : 0;
+			break;
+		case JEDEC_READ:
+			if (emu.pos < 4)
+				emu.addr = (emu.addr << 8 | in) % FLASH_SIZE;
+			else
+				out = emu.mem[emu.addr++ % FLASH_SIZE];
+			break;
+		case JEDEC_BYTE_PROGRAM:
+			if (emu.pos < 4)
+				emu.addr = (emu.addr << 8 | in) % FLASH_SIZE;
+			else
+				emu.page[emu.page_len++ % PAGE_SIZE] = in;
+			if (emu.page_len > PAGE_SIZE)
+				emu.page_len = PAGE_SIZE;
+			break;
+		}
+	}
+	emu.pos++;
+	return out;
+}
+
+/* The CH341A. Returns 0 if the packet has to wait for the previous reply to be picked up. */
+static int ch341a_run(const uint8_t *pkt, unsigned int len)
+{
+	unsigned int i;
+	int cs;
+
+	switch (pkt[0]) {
+	case CH341A_CMD_UIO_STREAM:
+		for (i = 1; i < len && pkt[i] != CH341A_CMD_UIO_STM_END; i++) {
+			switch (pkt[i] & 0xc0) {
+			case CH341A_CMD_UIO_STM_OUT:
+				/* CS# is D0. */
+				cs = !(pkt[i] & 0x01);
+				if (cs && !emu.cs)
+					flash_select();
+				else if (!cs && emu.cs)
+					flash_deselect();
+				emu.cs = cs;
+				emu.ns += UIO_NS;
+				break;
+			case CH341A_CMD_UIO_STM_US:
+				emu.ns += (pkt[i] & 0x3f) * 1000ULL;
+				break;
+			}
+		}
+		if (i == len)
+			emu_error("UIO stream packet without end.\n");
+		break;
+	case CH341A_CMD_SPI_STREAM:
+		if (emu.reply_len)
+			return 0;
+		if (!emu.cs)
+			emu_error("SPI stream with CS# deasserted.\n");
+		for (i = 1; i < len; i++)
+			emu.reply[i - 1] = reversed_bits[flash_byte(reversed_bits[pkt[i]])];
+		emu.reply_len = len - 1;
+		emu.ns += (len - 1) * SPI_BYTE_NS;
+		break;
+	case CH341A_CMD_I2C_STREAM:
+		break;
+	default:
+		emu_error("unknown packet 0x%02x.\n", pkt[0]);
+		break;
+	}
+	return 1;
+}
+
+/* The libusb replacements */
+static int emu_libusb_init(struct libusb_context **ctx)
+{
+	return 0;
+}
+
+static void emu_libusb_exit(struct libusb_context *ctx)
+{
+}
+
+static void emu_libusb_set_debug(struct libusb_context *ctx, int level)
+{
+}
+
+static struct libusb_device_handle *emu_libusb_open_device_with_vid_pid(struct libusb_context *ctx, uint16_t vid,
+									 uint16_t pid)
+{
+	static char device;
+
+	return (struct libusb_device_handle *)&device;
+}
+
+static void emu_libusb_close(struct libusb_device_handle *dev_handle)
+{
+}
+
+static int emu_libusb_detach_kernel_driver(struct libusb_device_handle *dev_handle, int interface)
+{
+	return LIBUSB_ERROR_NOT_FOUND;
+}
+
+static int emu_libusb_claim_interface(struct libusb_device_handle *dev_handle, int interface)
+{
+	return 0;
+}
+
+static int emu_libusb_release_interface(struct libusb_device_handle *dev_handle, int interface)
+{
+	return 0;
+}
+
+static struct libusb_device *emu_libusb_get_device(struct libusb_device_handle *dev_handle)
+{
+	return (struct libusb_device *)dev_handle;
+}
+
+static int emu_libusb_get_device_descriptor(struct libusb_device *dev, struct libusb_device_descriptor *desc)
+{
+	memset(desc, 0, sizeof(*desc));
+	desc->bcdDevice = 0x0304;
+	return 0;
+}
+
+static struct libusb_transfer *emu_libusb_alloc_transfer(int iso_packets)
+{
+	return calloc(1, sizeof(struct libusb_transfer));
+}
+
+static void emu_libusb_free_transfer(struct libusb_transfer *transfer)
+{
+	free(transfer);
+}
+
+static int emu_libusb_submit_transfer(struct libusb_transfer *transfer)
+{
+	unsigned int i;
+
+	for (i = 0; i < emu.queued; i++) {
+		if (emu.queue[i] == transfer) {
+			emu_error("transfer submitted twice.\n");
+			return LIBUSB_ERROR_BUSY;
+		}
+	}
+	if (emu.queued == MAX_QUEUED) {
+		emu_error("too many transfers queued.\n");
+		return LIBUSB_ERROR_NO_MEM;
+	}
+	/* Everything sent before has been answered, the host waited for a full round trip. */
+	if (!emu.queued)
+		emu.round_trips++;
+	emu.queue[emu.queued++] = transfer;
+	if (transfer->endpoint == WRITE_EP)
+		emu.out_transfers++;
+	else
+		emu.in_transfers++;
+	return 0;
+}
+
+/* Removes transfer from the queue and runs its callback with status. */
+static void emu_finish(struct libusb_transfer *transfer, enum libusb_transfer_status status, int actual_length)
+{
+	unsigned int i;
+
+	for (i = 0; emu.queue[i] != transfer; i++)
+		;
+	memmove(emu.queue + i, emu.queue + i + 1, (emu.queued - i - 1) * sizeof(*emu.queue));
+	emu.queued--;
+	if (transfer->endpoint == WRITE_EP)
+		emu.out_pos = 0;
+	transfer->status = status;
+	transfer->actual_length = actual_length;
+	transfer->callback(transfer);
+}
+
+static int emu_libusb_cancel_transfer(struct libusb_transfer *transfer)
+{
+	unsigned int i;
+
+	for (i = 0; i < emu.queued; i++) {
+		if (emu.queue[i] == transfer) {
+			emu_finish(transfer, LIBUSB_TRANSFER_CANCELLED, 0);
+			return 0;
+		}
+	}
+	return LIBUSB_ERROR_NOT_FOUND;
+}
+
+static struct libusb_transfer *emu_first(unsigned char endpoint)
+{
+	unsigned int i;
+
+	for (i = 0; i < emu.queued; i++) {
+		if (emu.queue[i]->endpoint == endpoint)
+			return emu.queue[i];
+	}
+	return NULL;
+}
+
+/* Moves as much data as possible. */
+static int emu_libusb_handle_events_timeout(struct libusb_context *ctx, struct timeval *tv)
+{
+	struct libusb_transfer *out, *in;
+	unsigned int len;
+	int progress = 0;
+
+	while (1) {
+		in = emu_first(READ_EP);
+		if (emu.reply_len && in) {
+			if (emu.reply_len > in->length) {
+				emu_error("reply of %u bytes to a %d byte IN transfer.\n", emu.reply_len, in->length);
+				emu_finish(in, LIBUSB_TRANSFER_OVERFLOW, 0);
+			} else {
+				memcpy(in->buffer, emu.reply, emu.reply_len);
+				emu_finish(in, LIBUSB_TRANSFER_COMPLETED, emu.reply_len);
+			}
+			emu.reply_len = 0;
+			progress = 1;
+			continue;
+		}
+		out = emu_first(WRITE_EP);
+		if (!out)
+			break;
+		if (emu.out_pos < out->length) {
+			len = min(CH341_PACKET_LENGTH, out->length - emu.out_pos);
+			if (!ch341a_run(out->buffer + emu.out_pos, len))
+				break;
+			emu.out_pos += len;
+		}
+		/* Like all USB transfers, this one has been acknowledged once its last packet has been taken. */
+		if (emu.out_pos == out->length)
+			emu_finish(out, LIBUSB_TRANSFER_COMPLETED, out->length);
+		progress = 1;
+	}
+	if (!progress && emu.queued) {
+		emu_error("nothing moves with %u transfers queued, they time out.\n", emu.queued);
+		while (emu.queued)
+			emu_finish(emu.queue[0], LIBUSB_TRANSFER_TIMED_OUT, 0);
+	}
+	return 0;
+}
+
+static const char *emu_libusb_error_name(int code)
+{
+	return "emulated error";
+}
+
+/* The tests */
+static unsigned int failures;
+
+static void check(int cond, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	printf("%s: ", cond && !emu.errors ? "PASS" : "FAIL");
+	vprintf(fmt, ap);
+	printf("\n");
+	va_end(ap);
+	if (!cond || emu.errors)
+		failures++;
+	emu.errors = 0;
+}
+
+static void wait_idle(void)
+{
+	emu.ns = emu.busy_until;
+}
+
+static void test_command(struct flashctx *flash)
+{
+	const unsigned char rdid = JEDEC_RDID;
+	unsigned char id[3];
+	int ret;
+
+	ret = registered->command(flash, 1, sizeof(id), &rdid, id);
+	check(!ret && id[0] == 0xef && id[1] == 0x40 && id[2] == 0x14 && !emu.queued,
+	      "RDID returns %02x %02x %02x", id[0], id[1], id[2]);
+}
+
+static void test_multicommand(struct flashctx *flash, unsigned int addr, unsigned int delay_us)
+{
+	const unsigned char wren = JEDEC_WREN;
+	unsigned char pp[4 + PAGE_SIZE] = { JEDEC_BYTE_PROGRAM, addr >> 16, addr >> 8, addr };
+	unsigned char rdsr = JEDEC_RDSR, status = 0xff;
+	struct spi_command cmds[] = {
+		{ .writecnt = 1, .writearr = &wren },
+		{ .writecnt = sizeof(pp), .writearr = pp, .delay_us = delay_us },
+		{ .writecnt = 1, .writearr = &rdsr, .readcnt = 1, .readarr = &status },
+		{ 0 },
+	};
+	unsigned int i, out_transfers, round_trips;
+	int ret;
+
+	/* Programming only clears bits. */
+	for (i = 0; i < PAGE_SIZE; i++) {
+		pp[4 + i] = rand();
+		shadow[addr + i] &= pp[4 + i];
+	}
+	out_transfers = emu.out_transfers;
+	round_trips = emu.round_trips;
+	ret = registered->multicommand(flash, cmds);
+	/* Single commands leave CS# asserted until the next one, hence the host delay passes before PP starts. */
+	check(!ret && (status == 0 || delay_us > CH341A_MAX_GAP_US), "WREN, PP, %u us delay and RDSR (status 0x%02x)",
+	      delay_us, status);
+	check(!memcmp(emu.mem + addr, shadow + addr, PAGE_SIZE), "page programmed");
+	/* Packed, every command is an OUT transfer of its own and all of them are queued without waiting. */
+	if (delay_us <= CH341A_MAX_GAP_US)
+		check(emu.out_transfers - out_transfers <= ARRAY_SIZE(cmds) - 1 && emu.round_trips - round_trips == 1,
+		      "multicommand in %u OUT transfers and %u round trips", emu.out_transfers - out_transfers,
+		      emu.round_trips - round_trips);
+	wait_idle();
+}
+
+static void test_poll(struct flashctx *flash, unsigned int delay_us, unsigned int step_us)
+{
+	const unsigned char wren = JEDEC_WREN;
+	unsigned char pp[4 + 16] = { JEDEC_BYTE_PROGRAM, 0x02, 0x00, 0x00 };
+	struct spi_command cmds[] = {
+		{ .writecnt = 1, .writearr = &wren },
+		{ .writecnt = sizeof(pp), .writearr = pp },
+		{ 0 },
+	};
+	uint8_t status[8];
+	unsigned int i, expected, out_transfers, round_trips;
+	int ret;
+
+	memset(pp + 4, 0xff, sizeof(pp) - 4);
+	out_transfers = emu.out_transfers;
+	round_trips = emu.round_trips;
+	ret = registered->multicommand_poll(flash, cmds, delay_us, step_us, ARRAY_SIZE(status), status);
+	/* The framing of each poll takes a few microseconds, hence allow one poll less. */
+	expected = delay_us >= PP_US ? 0 : (PP_US - delay_us + step_us - 1) / step_us;
+	for (i = 0; i < ARRAY_SIZE(status) && (status[i] & SPI_SR_WIP); i++)
+		;
+	check(!ret && (i == min(expected, ARRAY_SIZE(status)) || i + 1 == min(expected, ARRAY_SIZE(status))),
+	      "%u of the polls %u us apart %u us after PP report busy (expected %u)", i, step_us, delay_us,
+	      expected);
+	check(emu.out_transfers - out_transfers <= ARRAY_SIZE(cmds) - 1 + ARRAY_SIZE(status) &&
+	      emu.round_trips - round_trips == 1, "poll in %u OUT transfers and %u round trips",
+	      emu.out_transfers - out_transfers, emu.round_trips - round_trips);
+	wait_idle();
+	ret = registered->multicommand_poll(flash, cmds, CH341A_MAX_GAP_US + 1, step_us, 1, status);
+	check(ret == SPI_INVALID_OPCODE && !emu.queued, "poll after %u us is refused", CH341A_MAX_GAP_US + 1);
+}
+
+/*
+ * Besides the data, this checks the number of transfers: one OUT transfer for the opcode and one per
+ * READ_PER_OUT bytes, one IN transfer for the reply to the opcode and one per SPI stream packet, and one round trip
+ * per OUT transfer of dummy bytes at most.
+ */
+static void test_read(struct flashctx *flash, unsigned int start, unsigned int len)
+{
+	uint8_t *buf = malloc(len);
+	unsigned int out_transfers = emu.out_transfers, in_transfers = emu.in_transfers;
+	unsigned int round_trips = emu.round_trips;
+	unsigned int outs = (len + READ_PER_OUT - 1) / READ_PER_OUT;
+	unsigned int packets = (len + READ_PER_PACKET - 1) / READ_PER_PACKET;
+	int ret;
+
+	if (!buf) {
+		fprintf(stderr, "Out of memory!\n");
+		exit(1);
+	}
+	memset(buf, 0, len);
+	ret = registered->read(flash, buf, start, len);
+	check(!ret && !memcmp(buf, shadow + start, len) && !emu.queued && !emu.reply_len,
+	      "read of %u bytes at 0x%06x", len, start);
+	out_transfers = emu.out_transfers - out_transfers;
+	in_transfers = emu.in_transfers - in_transfers;
+	round_trips = emu.round_trips - round_trips;
+	check(out_transfers <= 1 + outs && in_transfers <= 1 + packets && round_trips <= 1 + outs,
+	      "read of %u bytes in %u OUT transfers (max. %u), %u IN transfers (max. %u) and %u round trips "
+	      "(max. %u)", len, out_transfers, 1 + outs, in_transfers, 1 + packets, round_trips, 1 + outs);
+	free(buf);
+}
+
+int main(int argc, char *argv[])
+{
+	struct flashctx flash = { 0 };
+	unsigned int i;
+
+	srand(0);
+	for (i = 0; i < FLASH_SIZE; i++)
+		emu.mem[i] = shadow[i] = rand();
+
+	check(!ch341a_spi_init() && registered, "init");
+	test_command(&flash);
+	test_multicommand(&flash, 0x12300, PP_US);
+	test_multicommand(&flash, 0x12400, CH341A_MAX_GAP_US + 1);
+	test_poll(&flash, 100, 250);
+	test_poll(&flash, 1000, 100);
+	test_read(&flash, 0, 1);
+	test_read(&flash, 0x12345, 30);
+	test_read(&flash, 0x12345, 31);
+	test_read(&flash, 0x12345, 32);
+	test_read(&flash, 0x10000, 1000);
+	test_read(&flash, 0x10000, 256 * 31);
+	test_read(&flash, 0x10000, 256 * 31 + 1);
+	test_read(&flash, 0x0ffff, 300000);
+	test_read(&flash, 0, FLASH_SIZE);
+	test_command(&flash);
+	ch341a_spi_shutdown(NULL);
+
+	printf("%u failures\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,656 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Software MPSSE emulator behind the libftdi calls of ft2232_spi.c, with a SPI flash chip attached to it.
+ *
+ * The libftdi functions used by the driver are replaced by ones interpreting the MPSSE command stream, so the
+ * driver code runs unmodified without any hardware. The emulated chip checks that nothing but RDSR is sent while
+ * a program or erase operation is running, with the time derived from the bus clocks. That way it catches delays
+ * that are too short in the packed multicommand and poll transfers. It also insists that at most one libftdi
+ * read is in flight at any time, because libftdi keeps the state of asynchronous reads in its context.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftdi.h>
+
+/* Reroute the libftdi calls of the driver to the emulator. Its prototypes differ between libftdi versions. */
+#define ftdi_init			emu_ftdi_init
+#define ftdi_set_interface		emu_ftdi_set_interface
+#define ftdi_usb_open_desc		emu_ftdi_usb_open_desc
+#define ftdi_usb_reset			emu_ftdi_usb_reset
+#define ftdi_usb_close			emu_ftdi_usb_close
+#define ftdi_set_latency_timer		emu_ftdi_set_latency_timer
+#define ftdi_write_data_set_chunksize	emu_ftdi_write_data_set_chunksize
+#define ftdi_set_bitmode		emu_ftdi_set_bitmode
+#define ftdi_get_error_string		emu_ftdi_get_error_string
+#define ftdi_write_data			emu_ftdi_write_data
+#define ftdi_read_data			emu_ftdi_read_data
+#if HAVE_FTDI_ASYNC
+#define ftdi_read_data_submit		emu_ftdi_read_data_submit
+#define ftdi_transfer_data_done		emu_ftdi_transfer_data_done
+#endif
+
+static int emu_ftdi_init(struct ftdi_context *ftdic);
+static int emu_ftdi_set_interface(struct ftdi_context *ftdic, enum ftdi_interface interface);
+static int emu_ftdi_usb_open_desc(struct ftdi_context *ftdic, int vendor, int product, const char *description,
+				  const char *serial);
+static int emu_ftdi_usb_reset(struct ftdi_context *ftdic);
+static int emu_ftdi_usb_close(struct ftdi_context *ftdic);
+static int emu_ftdi_set_latency_timer(struct ftdi_context *ftdic, unsigned char latency);
+static int emu_ftdi_write_data_set_chunksize(struct ftdi_context *ftdic, unsigned int chunksize);
+static int emu_ftdi_set_bitmode(struct ftdi_context *ftdic, unsigned char bitmask, unsigned char mode);
+static const char *emu_ftdi_get_error_string(struct ftdi_context *ftdic);
+static int emu_ftdi_write_data(struct ftdi_context *ftdic, const unsigned char *buf, int size);
+static int emu_ftdi_read_data(struct ftdi_context *ftdic, unsigned char *buf, int size);
+#if HAVE_FTDI_ASYNC
+static struct ftdi_transfer_control *emu_ftdi_read_data_submit(struct ftdi_context *ftdic, unsigned char *buf,
+								int size);
+static int emu_ftdi_transfer_data_done(struct ftdi_transfer_control *tc);
+#endif
+
+#include "ft2232_spi.c"
+
+#define FLASH_SIZE	(1024 * 1024)
+#define PAGE_SIZE	256
+#define PP_US		700
+#define SE_US		45000
+
+static struct {
+	/* MPSSE state */
+	unsigned int clock_khz;
+	unsigned int divisor;
+	int div5;
+	int cs;
+	uint64_t clocks;
+	unsigned char *rx;
+	size_t rx_size, rx_head, rx_tail;
+	struct ftdi_transfer_control *pending;
+	/* Statistics */
+	unsigned int writes, reads, errors;
+	/* Fail the write that many writes from now, 0 to never fail */
+	unsigned int fail_write_in;
+	/* SPI flash state */
+	uint8_t mem[FLASH_SIZE];
+	uint8_t page[PAGE_SIZE];
+	unsigned int pos, opcode, addr, page_len;
+	int wel;
+	uint64_t busy_until;
+} emu;
+
+static uint8_t shadow[FLASH_SIZE];
+
+int print(enum msglevel level, const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	if (level > MSG_WARN)
+		return 0;
+	va_start(ap, fmt);
+	ret = vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	return ret;
+}
+
+static void emu_error(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fprintf(stderr, "EMULATOR: ");
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	emu.errors++;
+}
+
+/* Stubs for the flashrom core functions used by the driver. */
+char *extract_programmer_param(const char *param_name)
+{
+	return NULL;
+}
+
+static const struct spi_master *registered;
+
+int register_spi_master(const struct spi_master *mst)
+{
+	registered = mst;
+	return 0;
+}
+
+int spi_prepare_read(struct flashctx *flash, uint8_t *cmd, unsigned int addr)
+{
+	cmd[0] = JEDEC_READ;
+	cmd[1] = (addr >> 16) & 0xff;
+	cmd[2] = (addr >> 8) & 0xff;
+	cmd[3] = addr & 0xff;
+	return 4;
+}
+
+int default_spi_send_multicommand(struct flashctx *flash, struct spi_command *cmds)
+{
+	int ret = 0;
+
+	for (; !ret && (cmds->writecnt || cmds->readcnt); cmds++)
+		ret = registered->command(flash, cmds->writecnt, cmds->readcnt, cmds->writearr, cmds->readarr);
+	return ret;
+}
+
+int default_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return 1;
+}
+
+int default_spi_write_256(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return 1;
+}
+
+int default_spi_write_aai(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return 1;
+}
+
+/* The SPI flash chip */
+static uint64_t us_to_clocks(unsigned int us)
+{
+	return (uint64_t)us * emu.clock_khz / 1000;
+}
+
+static int flash_busy(void)
+{
+	return emu.clocks < emu.busy_until;
+}
+
+static void flash_select(void)
+{
+	emu.pos = 0;
+	emu.page_len = 0;
+}
+
+static void flash_deselect(void)
+{
+	unsigned int i, base;
+
+	if (emu.pos == 0 || flash_busy())
+		return;
+	switch (emu.opcode) {
+	case JEDEC_WREN:
+		emu.wel = 1;
+		break;
+	case JEDEC_WRDI:
+		emu.wel = 0;
+		break;
+	case JEDEC_BYTE_PROGRAM:
+		if (!emu.wel || emu.pos < 4)
+			break;
+		base = emu.addr & ~(PAGE_SIZE - 1);
+		for (i = 0; i < emu.page_len; i++)
+			emu.mem[base + (emu.addr + i) % PAGE_SIZE] &= emu.page[i];
+		emu.busy_until = emu.clocks + us_to_clocks(PP_US);
+		emu.wel = 0;
+		break;
+	case JEDEC_SE:
+		if (!emu.wel || emu.pos != 4)
+			break;
+		memset(emu.mem + (emu.addr & ~0xfff), 0xff, 0x1000);
+		emu.busy_until = emu.clocks + us_to_clocks(SE_US);
+		emu.wel = 0;
+		break;
+	}
+}
+
+static uint8_t flash_byte(uint8_t in)
+{
+	uint8_t out = 0xff;
+
+	if (emu.pos == 0) {
+		emu.opcode = in;
+		emu.addr = 0;
+		if (flash_busy() && in != JEDEC_RDSR)
+			emu_error("opcode 0x%02x sent while the chip is busy.\n", in);
+	} else if (flash_busy()) {
+		if (emu.opcode == JEDEC_RDSR)
+			out = SPI_SR_WIP | (emu.wel ? SPI_SR_WEL : 0);
+	} else {
+		switch (emu.opcode) {
+		case JEDEC_RDID: {
+			static const uint8_t id[] = { 0xef, 0x40, 0x14 };
+			out = emu.pos <= sizeof(id) ? id[emu.pos - 1] : 0xff;
+			break;
+		}
+		case JEDEC_RDSR:
+			out = emu.wel ? SPI_SR_WEL : 0;
+			break;
+		case JEDEC_READ:
+			if (emu.pos < 4)
+				emu.addr = (emu.addr << 8 | in) % FLASH_SIZE;
+			else
+				out = emu.mem[emu.addr++ % FLASH_SIZE];
+			break;
+		case JEDEC_BYTE_PROGRAM:
+			if (emu.pos < 4)
+				emu.addr = (emu.addr << 8 | in) % FLASH_SIZE;
+			else
+				emu.page[emu.page_len++ % PAGE_SIZE] = in;
+			if (emu.page_len > PAGE_SIZE)
+				emu.page_len = PAGE_SIZE;
+			break;
+		case JEDEC_SE:
+			if (emu.pos < 4)
+				emu.addr = (emu.addr << 8 | in) % FLASH_SIZE;
+			break;
+		}
+	}
+	emu.pos++;
+	return out;
+}
+
+/* The MPSSE engine */
+static void rx_push(uint8_t b)
+{
+	if (emu.rx_tail == emu.rx_size) {
+		emu.rx_size = emu.rx_size ? emu.rx_size * 2 : 4096;
+		emu.rx = realloc(emu.rx, emu.rx_size);
+		if (!emu.rx) {
+			fprintf(stderr, "Out of memory!\n");
+			exit(1);
+		}
+	}
+	emu.rx[emu.rx_tail++] = b;
+}
+
+static size_t rx_pull(unsigned char *buf, size_t len)
+{
+	len = min(len, emu.rx_tail - emu.rx_head);
+	memcpy(buf, emu.rx + emu.rx_head, len);
+	emu.rx_head += len;
+	if (emu.rx_head == emu.rx_tail)
+		emu.rx_head = emu.rx_tail = 0;
+	return len;
+}
+
+static void mpsse_set_clock(void)
+{
+	emu.clock_khz = (emu.div5 ? 12000 : 60000) / ((1 + emu.divisor) * 2);
+}
+
+/* Runs the commands in buf. Commands split across writes are not supported, flashrom never does that. */
+static void mpsse_run(const unsigned char *buf, int size)
+{
+	unsigned int len, k;
+	int i = 0, cs;
+
+	while (i < size) {
+		const unsigned char op = buf[i++];
+		const int args = (op == LOOPBACK_END || op == 0x8a) ? 0 : 2;
+
+		if (size - i < args) {
+			emu_error("command 0x%02x truncated.\n", op);
+			return;
+		}
+		len = args ? (buf[i] | buf[i + 1] << 8) + 1 : 0;
+		i += args;
+		switch (op) {
+		case SET_BITS_LOW:
+			/* CS# is ADBUS3 on all supported adapters. */
+			cs = !(buf[i - 2] & 0x08);
+			if (cs && !emu.cs)
+				flash_select();
+			else if (!cs && emu.cs)
+				flash_deselect();
+			emu.cs = cs;
+			break;
+		case TCK_DIVISOR:
+			emu.divisor = len - 1;
+			mpsse_set_clock();
+			break;
+		case 0x8a: /* Disable divide-by-5. */
+			emu.div5 = 0;
+			mpsse_set_clock();
+			break;
+		case LOOPBACK_END:
+			break;
+		case MPSSE_DO_WRITE | MPSSE_WRITE_NEG:
+			if (size - i < len) {
+				emu_error("write of %u bytes truncated.\n", len);
+				return;
+			}
+			for (k = 0; k < len; k++)
+				if (emu.cs)
+					flash_byte(buf[i + k]);
+			i += len;
+			emu.clocks += 8 * len;
+			break;
+		case MPSSE_DO_READ:
+			for (k = 0; k < len; k++)
+				rx_push(emu.cs ? flash_byte(0xff) : 0xff);
+			emu.clocks += 8 * len;
+			break;
+		case 0x8f: /* Clock n bytes without data transfer. */
+			if (emu.cs)
+				emu_error("idle clocks with CS# asserted.\n");
+			emu.clocks += 8 * len;
+			break;
+		default:
+			/* The MPSSE answers unknown commands with 0xfa and the command. */
+			emu_error("bad command 0x%02x.\n", op);
+			rx_push(0xfa);
+			rx_push(op);
+			return;
+		}
+	}
+}
+
+/* The libftdi replacements */
+static int emu_ftdi_init(struct ftdi_context *ftdic)
+{
+	memset(ftdic, 0, sizeof(*ftdic));
+	return 0;
+}
+
+static int emu_ftdi_set_interface(struct ftdi_context *ftdic, enum ftdi_interface interface)
+{
+	return 0;
+}
+
+static int emu_ftdi_usb_open_desc(struct ftdi_context *ftdic, int vendor, int product, const char *description,
+				  const char *serial)
+{
+	ftdic->type = TYPE_2232H;
+	emu.div5 = 1;
+	emu.divisor = 0;
+	mpsse_set_clock();
+	return 0;
+}
+
+static int emu_ftdi_usb_reset(struct ftdi_context *ftdic)
+{
+	return 0;
+}
+
+static int emu_ftdi_usb_close(struct ftdi_context *ftdic)
+{
+	return 0;
+}
+
+static int emu_ftdi_set_latency_timer(struct ftdi_context *ftdic, unsigned char latency)
+{
+	return 0;
+}
+
+static int emu_ftdi_write_data_set_chunksize(struct ftdi_context *ftdic, unsigned int chunksize)
+{
+	return 0;
+}
+
+static int emu_ftdi_set_bitmode(struct ftdi_context *ftdic, unsigned char bitmask, unsigned char mode)
+{
+	return 0;
+}
+
+static const char *emu_ftdi_get_error_string(struct ftdi_context *ftdic)
+{
+	return "emulated error";
+}
+
+static int emu_ftdi_write_data(struct ftdi_context *ftdic, const unsigned char *buf, int size)
+{
+	if (emu.fail_write_in && !--emu.fail_write_in)
+		return -1;
+	emu.writes++;
+	mpsse_run(buf, size);
+	return size;
+}
+
+static int emu_ftdi_read_data(struct ftdi_context *ftdic, unsigned char *buf, int size)
+{
+	if (emu.pending) {
+		emu_error("synchronous read while an asynchronous one is in flight.\n");
+		return -1;
+	}
+	emu.reads++;
+	/* Real hardware would keep returning nothing, and get_buf() would never return. */
+	if (emu.rx_head == emu.rx_tail) {
+		emu_error("read of %d bytes without any data to come.\n", size);
+		return -1;
+	}
+	return rx_pull(buf, size);
+}
+
+#if HAVE_FTDI_ASYNC
+static struct ftdi_transfer_control *emu_ftdi_read_data_submit(struct ftdi_context *ftdic, unsigned char *buf,
+								int size)
+{
+	struct ftdi_transfer_control *tc;
+
+	if (emu.pending) {
+		emu_error("second asynchronous read submitted, libftdi would mix up their data.\n");
+		return NULL;
+	}
+	tc = calloc(1, sizeof(*tc));
+	if (!tc)
+		return NULL;
+	tc->buf = buf;
+	tc->size = size;
+	tc->ftdi = ftdic;
+	emu.pending = tc;
+	emu.reads++;
+	return tc;
+}
+
+static int emu_ftdi_transfer_data_done(struct ftdi_transfer_control *tc)
+{
+	int ret;
+
+	if (tc != emu.pending) {
+		emu_error("unknown transfer completed.\n");
+		return -1;
+	}
+	tc->offset = rx_pull(tc->buf, tc->size);
+	ret = tc->offset;
+	/* Real hardware would never complete the transfer. */
+	if (ret != tc->size) {
+		emu_error("transfer of %d bytes with only %d bytes to come.\n", tc->size, ret);
+		ret = -1;
+	}
+	emu.pending = NULL;
+	free(tc);
+	return ret;
+}
+
+#endif
+
+/* The tests */
+static unsigned int failures;
+
+static void check(int cond, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	printf("%s: ", cond && !emu.errors ? "PASS" : "FAIL");
+	vprintf(fmt, ap);
+	printf("\n");
+	va_end(ap);
+	if (!cond || emu.errors)
+		failures++;
+	emu.errors = 0;
+}
+
+static void wait_idle(void)
+{
+	emu.clocks = emu.busy_until;
+}
+
+static void test_command(struct flashctx *flash)
+{
+	const unsigned char rdid = JEDEC_RDID;
+	unsigned char id[3];
+	int ret;
+
+	ret = registered->command(flash, 1, sizeof(id), &rdid, id);
+	check(!ret && id[0] == 0xef && id[1] == 0x40 && id[2] == 0x14, "RDID returns %02x %02x %02x",
+	      id[0], id[1], id[2]);
+}
+
+static void test_multicommand(struct flashctx *flash)
+{
+	const unsigned char wren = JEDEC_WREN;
+	unsigned char pp[4 + PAGE_SIZE] = { JEDEC_BYTE_PROGRAM, 0x01, 0x23, 0x00 };
+	unsigned char rdsr = JEDEC_RDSR, status = 0xff;
+	struct spi_command cmds[] = {
+		{ .writecnt = 1, .writearr = &wren },
+		{ .writecnt = sizeof(pp), .writearr = pp, .delay_us = PP_US },
+		{ .writecnt = 1, .writearr = &rdsr, .readcnt = 1, .readarr = &status },
+		{ 0 },
+	};
+	unsigned int i, writes = emu.writes;
+	int ret;
+
+	/* Programming only clears bits. */
+	for (i = 0; i < PAGE_SIZE; i++) {
+		pp[4 + i] = rand();
+		shadow[0x12300 + i] &= pp[4 + i];
+	}
+	ret = registered->multicommand(flash, cmds);
+	check(!ret && emu.writes == writes + 1, "WREN, PP, delay and RDSR packed into one transfer (%u)",
+	      emu.writes - writes);
+	check(status == 0, "delay after PP is long enough (status 0x%02x)", status);
+	check(!memcmp(emu.mem + 0x12300, shadow + 0x12300, PAGE_SIZE), "page programmed");
+	wait_idle();
+}
+
+static void test_poll(struct flashctx *flash, unsigned int delay_us, unsigned int step_us)
+{
+	const unsigned char wren = JEDEC_WREN;
+	const unsigned char se[] = { JEDEC_SE, 0x01, 0x20, 0x00 };
+	struct spi_command cmds[] = {
+		{ .writecnt = 1, .writearr = &wren },
+		{ .writecnt = sizeof(se), .writearr = se },
+		{ 0 },
+	};
+	uint8_t status[8];
+	unsigned int i, writes = emu.writes, expected;
+	int ret;
+
+	memset(shadow + 0x12000, 0xff, 0x1000);
+	ret = registered->multicommand_poll(flash, cmds, delay_us, step_us, ARRAY_SIZE(status), status);
+	/* The framing of each poll takes a few clocks, hence allow one poll less. */
+	expected = delay_us >= SE_US ? 0 : (SE_US - delay_us + step_us - 1) / step_us;
+	for (i = 0; i < ARRAY_SIZE(status) && (status[i] & SPI_SR_WIP); i++)
+		;
+	check(!ret && emu.writes == writes + 1, "WREN, SE and %zu polls packed into one transfer (%u)",
+	      ARRAY_SIZE(status), emu.writes - writes);
+	check(i == min(expected, ARRAY_SIZE(status)) || i + 1 == min(expected, ARRAY_SIZE(status)),
+	      "%u of the polls %u us apart %u us after SE report busy (expected %u)", i, step_us, delay_us,
+	      expected);
+	wait_idle();
+	check(!memcmp(emu.mem + 0x12000, shadow + 0x12000, 0x1000), "sector erased");
+}
+
+static void test_unpackable(struct flashctx *flash)
+{
+	const unsigned char read[] = { JEDEC_READ, 0x00, 0x10, 0x00 };
+	unsigned char data[FT2232_MAX_PACKED_READ + 1];
+	struct spi_command cmds[] = {
+		{ .writecnt = sizeof(read), .writearr = read, .readcnt = sizeof(data), .readarr = data },
+		{ 0 },
+	};
+	uint8_t status;
+	int ret;
+
+	ret = registered->multicommand(flash, cmds);
+	check(!ret && !memcmp(data, shadow + 0x1000, sizeof(data)), "%zu byte response falls back to single commands",
+	      sizeof(data));
+	ret = registered->multicommand_poll(flash, cmds, 10, 10, 1, &status);
+	check(ret == SPI_INVALID_OPCODE, "poll with a %zu byte response is refused", sizeof(data));
+}
+
+#if HAVE_FTDI_ASYNC
+static void test_read(struct flashctx *flash, unsigned int start, unsigned int len)
+{
+	uint8_t *buf = malloc(len);
+	unsigned int reads = emu.reads;
+	int ret;
+
+	if (!buf) {
+		fprintf(stderr, "Out of memory!\n");
+		exit(1);
+	}
+	memset(buf, 0, len);
+	ret = registered->read(flash, buf, start, len);
+	check(!ret && !memcmp(buf, shadow + start, len) && !emu.cs && emu.rx_head == emu.rx_tail,
+	      "read of %u bytes at 0x%06x in %u transfers", len, start, emu.reads - reads);
+	free(buf);
+}
+
+static void test_read_failure(struct flashctx *flash)
+{
+	uint8_t *buf = malloc(FLASH_SIZE);
+	int ret;
+
+	if (!buf) {
+		fprintf(stderr, "Out of memory!\n");
+		exit(1);
+	}
+	/* The fourth write queues the fourth read command. */
+	emu.fail_write_in = 4;
+	ret = registered->read(flash, buf, 0, FLASH_SIZE);
+	check(ret && !emu.pending && !emu.cs, "failed read returns an error after its pending transfer finished");
+	/* Flush what the aborted read left behind. */
+	emu.rx_head = emu.rx_tail = 0;
+	free(buf);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+	struct flashctx flash = { 0 };
+	unsigned int i;
+
+	srand(0);
+	for (i = 0; i < FLASH_SIZE; i++)
+		emu.mem[i] = shadow[i] = rand();
+
+	check(!ft2232_spi_init() && registered, "init");
+	check(emu.clock_khz == 30000 && idle_clock_khz == 30000, "bus clock %u kHz", emu.clock_khz);
+	test_command(&flash);
+	test_multicommand(&flash);
+	test_poll(&flash, 1000, 10000);
+	test_poll(&flash, 40000, 1000);
+	test_poll(&flash, 50000, 1000);
+	test_unpackable(&flash);
+#if HAVE_FTDI_ASYNC
+	test_read(&flash, 0, 1);
+	test_read(&flash, 0x12345, 300);
+	test_read(&flash, 0x10000, 65536);
+	test_read(&flash, 0x0ffff, 65537);
+	test_read(&flash, 0x12300, 300000);
+	test_read(&flash, 0, FLASH_SIZE);
+	test_read_failure(&flash);
+	test_read(&flash, 0x1000, 4096);
+#endif
+
+	printf("%u failures\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Microbenchmark of the buffer scanning kernels in memops.c. Every implementation the CPU supports is checked
+ * against the scalar one on buffers differing in a single byte first and then timed on its worst case, a scan
+ * over the whole buffer.
+ *
+ * Usage: memops_bench [size in KiB] [rounds]
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "memops.c"
+
+int print(enum msglevel level, const char *fmt, ...)
+{
+	return 0;
+}
+
+static const struct memops *all_ops[] = {
+	&scalar_ops,
+#if MEMOPS_X86
+	&sse2_ops,
+	&avx2_ops,
+#endif
+};
+
+static int supported(const struct memops *m)
+{
+#if MEMOPS_X86
+	__builtin_cpu_init();
+	if (m == &avx2_ops)
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+	if (m == &sse2_ops)
+		return __builtin_cpu_supports("sse2") && __builtin_cpu_supports("popcnt");
+#endif
+	return 1;
+}
+
+/* Compares m to the scalar kernels at all lengths and alignments up to 300 bytes. Returns the number of errors. */
+static unsigned int check(const struct memops *m)
+{
+	uint8_t a[512], b[512];
+	unsigned int len, off, pos, errors = 0;
+
+	for (len = 0; len <= 300; len++) {
+		for (off = 0; off < 32; off += 7) {
+			/* Make a and b equal or erased except for a single byte at pos, or len for none. */
+			for (pos = 0; pos <= len; pos += 1 + len / 16) {
+				memset(a, 0xff, sizeof(a));
+				memcpy(b, a, sizeof(b));
+				if (pos < len) {
+					a[off + pos] = rand();
+					b[off + pos] = rand();
+				}
+				errors += m->is_erased(a + off, len) != scalar_ops.is_erased(a + off, len);
+				errors += m->need_bits(a + off, b + off, len) !=
+					  scalar_ops.need_bits(a + off, b + off, len);
+				errors += m->need_bytes(a + off, b + off, len) !=
+					  scalar_ops.need_bytes(a + off, b + off, len);
+				errors += m->find(a + off, b + off, len, 0) != scalar_ops.find(a + off, b + off, len, 0);
+				errors += m->find(a + off, b + off, len, 1) != scalar_ops.find(a + off, b + off, len, 1);
+				errors += m->count_diff(a + off, b + off, len) !=
+					  scalar_ops.count_diff(a + off, b + off, len);
+			}
+		}
+	}
+	return errors;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Keeps the compiler from dropping the calls. */
+static volatile unsigned int sink;
+
+enum kernel { IS_ERASED, NEED_BITS, NEED_BYTES, FIRST_DIFF, FIRST_SAME, COUNT_DIFF, KERNELS };
+
+static const char *const kernel_names[KERNELS] = {
+	"mem_is_erased", "mem_need_erase_bits", "mem_need_erase_bytes",
+	"mem_first_diff", "mem_first_same", "mem_count_diff",
+};
+
+/* Returns the throughput in MiB/s of the given kernel of m over len bytes of a and b. */
+static double bench(const struct memops *m, enum kernel k, const uint8_t *a, const uint8_t *b, unsigned int len,
+		    unsigned int rounds)
+{
+	unsigned int r;
+	double start = now();
+
+	for (r = 0; r < rounds; r++) {
+		switch (k) {
+		case IS_ERASED:
+			sink = m->is_erased(a, len);
+			break;
+		case NEED_BITS:
+			sink = m->need_bits(a, b, len);
+			break;
+		case NEED_BYTES:
+			sink = m->need_bytes(a, b, len);
+			break;
+		case FIRST_DIFF:
+			sink = m->find(a, b, len, 0);
+			break;
+		case FIRST_SAME:
+			/* b is not erased and differs from a everywhere. */
+			sink = m->find(a, b + len, len, 1);
+			break;
+		default:
+			sink = m->count_diff(a, b, len);
+			break;
+		}
+	}
+	return (double)len * rounds / (now() - start) / (1024 * 1024);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int len = 16 * 1024 * 1024, rounds = 20, i, k, errors;
+	uint8_t *a, *b;
+
+	if (argc > 1)
+		len = strtoul(argv[1], NULL, 0) * 1024;
+	if (argc > 2)
+		rounds = strtoul(argv[2], NULL, 0);
+	if (!len || !rounds) {
+		fprintf(stderr, "Usage: %s [size in KiB] [rounds]\n", argv[0]);
+		return 1;
+	}
+
+	/* a and the first half of b are erased, the second half of b is 0x00. */
+	a = malloc(len);
+	b = malloc(2 * len);
+	if (!a || !b) {
+		fprintf(stderr, "Out of memory!\n");
+		return 1;
+	}
+	memset(a, 0xff, len);
+	memset(b, 0xff, len);
+	memset(b + len, 0x00, len);
+
+	printf("%-22s", "MiB/s");
+	for (i = 0; i < ARRAY_SIZE(all_ops); i++)
+		printf("%10s", all_ops[i]->name);
+	printf("\n");
+
+	errors = 0;
+	for (i = 0; i < ARRAY_SIZE(all_ops); i++) {
+		if (supported(all_ops[i]))
+			errors += check(all_ops[i]);
+	}
+
+	for (k = 0; k < KERNELS; k++) {
+		printf("%-22s", kernel_names[k]);
+		for (i = 0; i < ARRAY_SIZE(all_ops); i++) {
+			if (supported(all_ops[i]))
+				printf("%10.0f", bench(all_ops[i], k, a, b, len, rounds));
+			else
+				printf("%10s", "-");
+		}
+		printf("\n");
+	}
+
+	free(a);
+	free(b);
+	if (errors)
+		printf("%u results differ from the scalar implementation!\n", errors);
+	return errors ? 1 : 0;
+}